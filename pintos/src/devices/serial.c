@@ -1,7 +1,6 @@
 #include "devices/serial.h"
 #include <debug.h>
 #include "devices/input.h"
-#include "devices/intq.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
@@ -37,6 +36,10 @@
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable FIFOs, receive trigger at 1 byte. */
+#define FCR_CLEAR 0x06          /* Clear both FIFOs. */
+
 /* Line Control Register bits. */
 #define LCR_N81 0x03            /* No parity, 8 data bits, 1 stop bit. */
 #define LCR_DLAB 0x80           /* Divisor Latch Access Bit (DLAB). */
@@ -46,16 +49,38 @@
 
 /* Line Status Register. */
 #define LSR_DR 0x01             /* Data Ready: received data byte is in RBR. */
-#define LSR_THRE 0x20           /* THR Empty. */
+#define LSR_THRE 0x20           /* THR Empty, or transmit FIFO empty. */
+
+/* Size of the 16550A's transmit FIFO. */
+#define XMIT_FIFO_SIZE 16
 
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
-static struct intq txq;
+/* Data to be transmitted, in a ring buffer that kernel threads
+   add to and the interrupt handler takes from.  The handler
+   refills the whole transmit FIFO each time it runs, so heavy
+   output costs one interrupt per XMIT_FIFO_SIZE bytes rather
+   than one per byte.  TXQ_SIZE may be set to any power of 2. */
+#define TXQ_SIZE 4096
+static uint8_t txq[TXQ_SIZE];
+static size_t txq_head;                 /* Bytes ever added to TXQ. */
+static size_t txq_tail;                 /* Bytes ever sent from TXQ. */
+
+/* Threads waiting for room in TXQ.  The interrupt handler wakes
+   them up once TXQ is down to half full, not each time a byte
+   goes out. */
+static struct semaphore txq_room;
+static int txq_waiters;
+
+/* Contents of the interrupt enable register, which is only
+   written when they change. */
+static uint8_t ier;
 
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
+static void xmit_poll (void);
+static void xmit_burst (void);
 static void write_ier (void);
 static intr_handler_func serial_interrupt;
 
@@ -68,10 +93,11 @@ init_poll (void)
 {
   ASSERT (mode == UNINIT);
   outb (IER_REG, 0);                    /* Turn off all interrupts. */
-  outb (FCR_REG, 0);                    /* Disable FIFO. */
+  outb (FCR_REG, FCR_ENABLE | FCR_CLEAR); /* Enable FIFOs. */
   set_serial (9600);                    /* 9.6 kbps, N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-  intq_init (&txq);
+  sema_init (&txq_room, 0);
+  ier = 0;
   mode = POLL;
 }
 
@@ -98,45 +124,91 @@ serial_init_queue (void)
 void
 serial_putc (uint8_t byte)
 {
+  serial_putbuf (&byte, 1);
+}
+
+/* Sends the N bytes in BUFFER to the serial port. */
+void
+serial_putbuf (const void *buffer_, size_t n)
+{
+  const uint8_t *buffer = buffer_;
   enum intr_level old_level = intr_disable ();
 
   if (mode != QUEUE)
     {
       /* If we're not set up for interrupt-driven I/O yet,
-         use dumb polling to transmit a byte. */
+         use dumb polling to transmit the bytes. */
       if (mode == UNINIT)
         init_poll ();
-      putc_poll (byte);
+      while (n-- > 0)
+        putc_poll (*buffer++);
     }
   else
     {
-      /* Otherwise, queue a byte and update the interrupt enable
-         register. */
-      if (old_level == INTR_OFF && intq_full (&txq))
+      /* Otherwise, queue the bytes and update the interrupt
+         enable register. */
+      while (n > 0)
         {
-          /* Interrupts are off and the transmit queue is full.
-             If we wanted to wait for the queue to empty,
-             we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
-          putc_poll (intq_getc (&txq));
+          if (txq_head - txq_tail == TXQ_SIZE)
+            {
+              if (old_level == INTR_ON)
+                {
+                  /* Wait for the interrupt handler to make
+                     room. */
+                  txq_waiters++;
+                  write_ier ();
+                  sema_down (&txq_room);
+                }
+              else
+                {
+                  /* Interrupts are off and the transmit queue is
+                     full.  If we wanted to wait for the queue to
+                     empty, we'd have to reenable interrupts.
+                     That's impolite, so we'll send a FIFO's worth
+                     via polling instead. */
+                  xmit_poll ();
+                }
+              continue;
+            }
+
+          txq[txq_head++ % TXQ_SIZE] = *buffer++;
+          n--;
         }
-
-      intq_putc (&txq, byte);
       write_ier ();
     }
 
   intr_set_level (old_level);
 }
 
+/* Waits until the transmit queue has room for N bytes, at most
+   half its size, so that the caller can then queue them without
+   waiting.  Interrupts must be off, and are off again when this
+   function returns, but not while it waits. */
+void
+serial_wait_room (size_t n)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!intr_context ());
+  ASSERT (n <= TXQ_SIZE / 2);
+
+  if (mode != QUEUE)
+    return;
+  while (TXQ_SIZE - (txq_head - txq_tail) < n)
+    {
+      txq_waiters++;
+      write_ier ();
+      sema_down (&txq_room);
+    }
+}
+
 /* Flushes anything in the serial buffer out the port in polling
    mode. */
 void
 serial_flush (void)
 {
   enum intr_level old_level = intr_disable ();
-  while (!intq_empty (&txq))
-    putc_poll (intq_getc (&txq));
+  while (txq_head != txq_tail)
+    xmit_poll ();
   intr_set_level (old_level);
 }
 
@@ -176,21 +248,25 @@ set_serial (int bps)
 static void
 write_ier (void)
 {
-  uint8_t ier = 0;
+  uint8_t new_ier = 0;
 
   ASSERT (intr_get_level () == INTR_OFF);
 
   /* Enable transmit interrupt if we have any characters to
-     transmit. */
-  if (!intq_empty (&txq))
-    ier |= IER_XMIT;
+     transmit, or threads to wake up when they are gone. */
+  if (txq_head != txq_tail || txq_waiters > 0)
+    new_ier |= IER_XMIT;
 
   /* Enable receive interrupt if we have room to store any
      characters we receive. */
   if (!input_full ())
-    ier |= IER_RECV;
+    new_ier |= IER_RECV;
 
-  outb (IER_REG, ier);
+  if (new_ier != ier)
+    {
+      ier = new_ier;
+      outb (IER_REG, ier);
+    }
 }
 
 /* Polls the serial port until it's ready,
@@ -205,6 +281,29 @@ putc_poll (uint8_t byte)
   outb (THR_REG, byte);
 }
 
+/* Polls the serial port until its transmit FIFO is empty, and
+   then refills it from TXQ. */
+static void
+xmit_poll (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while ((inb (LSR_REG) & LSR_THRE) == 0)
+    continue;
+  xmit_burst ();
+}
+
+/* Moves as many bytes from TXQ into the transmit FIFO, which
+   must be empty, as it holds. */
+static void
+xmit_burst (void)
+{
+  size_t i;
+
+  for (i = 0; i < XMIT_FIFO_SIZE && txq_tail != txq_head; i++)
+    outb (THR_REG, txq[txq_tail++ % TXQ_SIZE]);
+}
+
 /* Serial interrupt handler. */
 static void
 serial_interrupt (struct intr_frame *f UNUSED)
@@ -218,10 +317,17 @@ serial_interrupt (struct intr_frame *f UNUSED)
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0)
-    outb (THR_REG, intq_getc (&txq));
+  /* If the transmit FIFO has emptied, refill it all at once. */
+  if ((inb (LSR_REG) & LSR_THRE) != 0)
+    xmit_burst ();
+
+  /* Wake up the threads waiting for room once there is plenty. */
+  if (txq_head - txq_tail <= TXQ_SIZE / 2)
+    while (txq_waiters > 0)
+      {
+        txq_waiters--;
+        sema_up (&txq_room);
+      }
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
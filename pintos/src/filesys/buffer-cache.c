@@ -1,6 +1,6 @@
 #include "filesys/buffer-cache.h"
 #include "threads/synch.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -11,13 +11,13 @@ static struct lock cache_lock;
 static struct list cache_list;  /* LRU list */
 
 static int hit_cnt;
-static struct lock hit_cnt_lock;
+static struct mutex hit_cnt_lock;
 
 static int read_cnt;
-static struct lock read_cnt_lock;
+static struct mutex read_cnt_lock;
 
 static int write_cnt;
-static struct lock write_cnt_lock;
+static struct mutex write_cnt_lock;
 
 typedef struct {
     struct list_elem elem;
@@ -30,7 +30,11 @@ typedef struct {
     struct condition cond;
 } cache_entry_t;
 
+/* Cache of cache entries. */
+static struct kmem_cache *cache_entry_cache;
+
 /* Create new cache entry. */
+static void cache_entry_ctor (void *);
 static cache_entry_t *cache_entry_init (void);
 static void get_buffer (cache_entry_t *, off_t, uint8_t *, off_t);
 static void put_buffer (cache_entry_t *entry,  off_t sector_ofs, const uint8_t *buffer,
@@ -44,22 +48,34 @@ cache_init (void)
   int i;
   lock_init (&cache_lock);
   list_init (&cache_list);
-  lock_init (&hit_cnt_lock);
-  lock_init (&read_cnt_lock);
-  lock_init (&write_cnt_lock);
+  mutex_init (&hit_cnt_lock);
+  mutex_init (&read_cnt_lock);
+  mutex_init (&write_cnt_lock);
+  cache_entry_cache = kmem_cache_create ("cache_entry",
+                                         sizeof (cache_entry_t), 0,
+                                         cache_entry_ctor);
   for (i = 0; i < CACHE_SIZE; ++i)
     list_push_back (&cache_list, &cache_entry_init ()->elem);
 }
 
+/* Initializes the lock and condition of ENTRY_, a new cache
+   entry. */
+static void
+cache_entry_ctor (void *entry_)
+{
+  cache_entry_t *entry = entry_;
+
+  lock_init (&entry->lock);
+  cond_init (&entry->cond);
+}
+
 static cache_entry_t *
 cache_entry_init (void)
 {
-  cache_entry_t *new = (cache_entry_t *)malloc (sizeof(cache_entry_t));
+  cache_entry_t *new = kmem_cache_alloc (cache_entry_cache);
   if (new == NULL) {
     return NULL;
   }
-  lock_init (&new->lock);
-  cond_init (&new->cond);
   new->modified = false;
   new->valid = false;
   return new;
@@ -83,9 +99,9 @@ cache_get (struct block* block, block_sector_t sector, off_t sector_ofs,
     hit_entry->modified = false;
     get_buffer (hit_entry, sector_ofs, buffer, size);
   }
-  lock_acquire (&read_cnt_lock);
+  mutex_acquire (&read_cnt_lock);
   ++read_cnt;
-  lock_release (&read_cnt_lock);
+  mutex_release (&read_cnt_lock);
   return 0;
 }
 
@@ -112,9 +128,9 @@ cache_put (struct block *block, block_sector_t sector, off_t sector_ofs,
     hit_entry->modified = true;
     put_buffer (hit_entry, sector_ofs, buffer, size);
   }
-  lock_acquire (&write_cnt_lock);
+  mutex_acquire (&write_cnt_lock);
   ++write_cnt;
-  lock_release (&write_cnt_lock);
+  mutex_release (&write_cnt_lock);
   return 0;
 }
 
@@ -170,9 +186,9 @@ loop:
           lock_release (&en->lock);
           goto loop;
         }
-        lock_acquire (&hit_cnt_lock);
+        mutex_acquire (&hit_cnt_lock);
         ++hit_cnt;
-        lock_release (&hit_cnt_lock);
+        mutex_release (&hit_cnt_lock);
         /* Move to head of cache list. */
         list_remove (&en->elem);
         list_push_front (&cache_list, &en->elem);
@@ -218,30 +234,30 @@ cache_flush (struct block* block)
       }
     }
   lock_release (&cache_lock);
-  lock_acquire (&hit_cnt_lock);
+  mutex_acquire (&hit_cnt_lock);
   hit_cnt = 0;
-  lock_release (&hit_cnt_lock);
-  lock_acquire (&read_cnt_lock);
+  mutex_release (&hit_cnt_lock);
+  mutex_acquire (&read_cnt_lock);
   read_cnt = 0;
-  lock_release (&read_cnt_lock);
-  lock_acquire (&write_cnt_lock);
+  mutex_release (&read_cnt_lock);
+  mutex_acquire (&write_cnt_lock);
   write_cnt = 0;
-  lock_release (&write_cnt_lock);
+  mutex_release (&write_cnt_lock);
 }
 
 void
 cache_stat (uint32_t *hit_cnt_,
             uint32_t *read_cnt_, uint32_t *write_cnt_)
 {
-  lock_acquire (&hit_cnt_lock);
+  mutex_acquire (&hit_cnt_lock);
   *hit_cnt_ = hit_cnt;
-  lock_release (&hit_cnt_lock);
+  mutex_release (&hit_cnt_lock);
 
-  lock_acquire (&read_cnt_lock);
+  mutex_acquire (&read_cnt_lock);
   *read_cnt_ = read_cnt;
-  lock_release (&read_cnt_lock);
+  mutex_release (&read_cnt_lock);
 
-  lock_acquire (&write_cnt_lock);
+  mutex_acquire (&write_cnt_lock);
   *write_cnt_ = write_cnt;
-  lock_release (&write_cnt_lock);
+  mutex_release (&write_cnt_lock);
 }
@@ -4,7 +4,8 @@
 #include <list.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 #include "filesys/buffer-cache.h"
 
 /* A directory. */
@@ -22,8 +23,18 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Cache of `struct dir'. */
+static struct kmem_cache *dir_cache;
+
 static bool is_dir_empty (struct inode *inode);
 
+/* Initializes the directory module. */
+void
+dir_init (void)
+{
+  dir_cache = kmem_cache_create ("dir", sizeof (struct dir), 0, NULL);
+}
+
 /* Init the root directory. */
 bool
 dir_root_init ()
@@ -52,8 +63,8 @@ dir_create (block_sector_t sector, size_t entry_cnt)
 struct dir *
 dir_open (struct inode *inode)
 {
-  struct dir *dir = calloc (1, sizeof *dir);
-  if (inode != NULL && dir != NULL)
+  struct dir *dir = inode != NULL ? kmem_cache_alloc (dir_cache) : NULL;
+  if (dir != NULL)
     {
       dir->inode = inode;
       dir->pos = 0;
@@ -62,7 +73,6 @@ dir_open (struct inode *inode)
   else
     {
       inode_close (inode);
-      free (dir);
       return NULL;
     }
 }
@@ -90,7 +100,7 @@ dir_close (struct dir *dir)
   if (dir != NULL)
     {
       inode_close (dir->inode);
-      free (dir);
+      kmem_cache_free (dir_cache, dir);
     }
 }
 
@@ -101,7 +111,15 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
-/* Searches DIR for a file with the given NAME.
+/* Directory entries are guarded by the directory inode's
+   inode_dir_lock(): lookups and readdir hold it for reading, so
+   they run in parallel, while dir_add() and dir_remove() hold
+   it for writing across their check and update.  A thread never
+   takes a child's lock and then its parent's, only the reverse
+   (dir_remove() checking that a subdirectory is empty). */
+
+/* Searches DIR for a file with the given NAME.  The caller must
+   hold DIR's lock.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
@@ -142,10 +160,12 @@ dir_lookup (const struct dir *dir, const char *name,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  rwlock_acquire_read (inode_dir_lock (dir->inode));
   if (lookup (dir, name, &e, NULL))
     *inode = inode_open (e.inode_sector);
   else
     *inode = NULL;
+  rwlock_release_read (inode_dir_lock (dir->inode));
 
   return *inode != NULL;
 }
@@ -184,6 +204,8 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
+  rwlock_acquire_write (inode_dir_lock (dir->inode));
+
   /* Check that NAME is not in use. */
   if (lookup (dir, name, NULL, NULL))
     goto done;
@@ -207,6 +229,7 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
  done:
+  rwlock_release_write (inode_dir_lock (dir->inode));
   return success;
 }
 
@@ -220,7 +243,9 @@ dir_equals (struct dir *dira, struct dir *dirb)
 
 /* Removes any entry for NAME in DIR.
    Returns true if successful, false on failure,
-   which occurs only if there is no file with the given NAME. */
+   which occurs if there is no file with the given NAME, if NAME
+   is "." or "..", or if NAME is a directory that is in use or
+   not empty. */
 bool
 dir_remove (struct dir *dir, const char *name)
 {
@@ -232,6 +257,12 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  /* These would take DIR's own lock or its parent's below. */
+  if (!strcmp (name, ".") || !strcmp (name, ".."))
+    return false;
+
+  rwlock_acquire_write (inode_dir_lock (dir->inode));
+
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
     goto done;
@@ -242,10 +273,9 @@ dir_remove (struct dir *dir, const char *name)
     goto done;
 
   if (is_inode_dir (inode)
-      && (!is_dir_empty (inode) || inode_open_cnt (inode) > 1)) {
-    inode_close (inode);
-    return false;
-  }
+      && (inode_open_cnt (inode) > 1 || !is_dir_empty (inode)))
+    goto done;
+
   /* Erase directory entry. */
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
@@ -256,6 +286,7 @@ dir_remove (struct dir *dir, const char *name)
   success = true;
 
  done:
+  rwlock_release_write (inode_dir_lock (dir->inode));
   inode_close (inode);
   return success;
 }
@@ -267,17 +298,21 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  bool found = false;
 
+  rwlock_acquire_read (inode_dir_lock (dir->inode));
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e)
     {
       dir->pos += sizeof e;
       if (e.in_use && strcmp (e.name, ".") && strcmp (e.name, ".."))
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          found = true;
+          break;
         }
     }
-  return false;
+  rwlock_release_read (inode_dir_lock (dir->inode));
+  return found;
 }
 
 off_t
@@ -292,15 +327,19 @@ is_dir_empty (struct inode *inode)
 {
   struct dir_entry e;
   size_t ofs;
+  bool empty = true;
 
   ASSERT (inode != NULL);
 
+  rwlock_acquire_read (inode_dir_lock (inode));
   for (ofs = 0; inode_read_at (inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e)
     if (e.in_use && strcmp (e.name, ".") && strcmp (e.name, ".."))
       {
-        return false;
+        empty = false;
+        break;
       }
-  return true;
+  rwlock_release_read (inode_dir_lock (inode));
+  return empty;
 }
 
@@ -14,6 +14,7 @@
 
 struct inode;
 
+void dir_init (void);
 bool dir_root_init (void);
 
 /* Opening and closing directories. */
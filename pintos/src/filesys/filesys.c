@@ -8,11 +8,13 @@
 #include "filesys/directory.h"
 #include "filesys/buffer-cache.h"
 #include "threads/thread.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
+/* Cache of `struct FILE', the handles filesys_open() returns. */
+static struct kmem_cache *handle_cache;
 
 static void do_format (void);
 static int get_next_part (char part[NAME_MAX + 1], const char **srcp);
@@ -29,6 +31,9 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
+  handle_cache = kmem_cache_create ("FILE", sizeof (struct FILE), 0, NULL);
+  file_init ();
+  dir_init ();
   inode_init ();
   free_map_init ();
   cache_init ();
@@ -119,7 +124,7 @@ filesys_open (const char *name)
   // open root directory
   if (file_name[0] == '\0') {
     dir_close (dir);
-    f = calloc (1, sizeof *f);
+    f = kmem_cache_alloc (handle_cache);
     f->is_dir = true;
     f->ptr.dir = dir_open_root ();
     return f;
@@ -132,7 +137,7 @@ filesys_open (const char *name)
   if (inode == NULL)
     return NULL;
 
-  f = calloc (1, sizeof *f);
+  f = kmem_cache_alloc (handle_cache);
   f->is_dir = is_inode_dir (inode);
   if (f->is_dir) {
     f->ptr.dir = dir_open (inode);
@@ -143,6 +148,38 @@ filesys_open (const char *name)
   return f;
 }
 
+/* Opens F again and returns the new handle, which starts out at
+   the same position as F.  Returns a null pointer if memory
+   allocation fails. */
+struct FILE *
+filesys_reopen (struct FILE *f)
+{
+  struct FILE *copy = kmem_cache_alloc (handle_cache);
+  bool ok;
+
+  if (copy == NULL)
+    return NULL;
+  copy->is_dir = f->is_dir;
+  if (f->is_dir)
+    {
+      copy->ptr.dir = dir_reopen (f->ptr.dir);
+      ok = copy->ptr.dir != NULL;
+    }
+  else
+    {
+      copy->ptr.file = file_reopen (f->ptr.file);
+      ok = copy->ptr.file != NULL;
+      if (ok)
+        file_seek (copy->ptr.file, file_tell (f->ptr.file));
+    }
+  if (!ok)
+    {
+      kmem_cache_free (handle_cache, copy);
+      return NULL;
+    }
+  return copy;
+}
+
 /* Close FILE F. Type of F may be dir or file. */
 void
 filesys_close (struct FILE *f)
@@ -153,7 +190,7 @@ filesys_close (struct FILE *f)
     } else {
       file_close (f->ptr.file);
     }
-    free (f);
+    kmem_cache_free (handle_cache, f);
   }
 }
 
@@ -26,6 +26,7 @@ struct FILE *filesys_open (const char *name);
 bool filesys_remove (const char *name);
 bool filesys_mkdir (const char *dir);
 bool filesys_chdir (const char *dir);
+struct FILE *filesys_reopen (struct FILE *);
 void filesys_close (struct FILE *);
 bool filesys_isdir (struct FILE *);
 int filesys_inumber (struct FILE *);
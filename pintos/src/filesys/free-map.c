@@ -9,7 +9,7 @@
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
 
-static struct lock free_map_lock;    /* Free map lock. */
+static struct mutex free_map_lock;    /* Free map lock. */
 
 /* Initializes the free map. */
 void
@@ -20,7 +20,7 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
-  lock_init (&free_map_lock);
+  mutex_init (&free_map_lock);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -31,7 +31,7 @@ free_map_init (void)
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  lock_acquire (&free_map_lock);
+  mutex_acquire (&free_map_lock);
   block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
   if (sector != BITMAP_ERROR
       && free_map_file != NULL
@@ -42,7 +42,7 @@ free_map_allocate (size_t cnt, block_sector_t *sectorp)
     }
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
-  lock_release (&free_map_lock);
+  mutex_release (&free_map_lock);
   return sector != BITMAP_ERROR;
 }
 
@@ -50,11 +50,11 @@ free_map_allocate (size_t cnt, block_sector_t *sectorp)
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
-  lock_acquire (&free_map_lock);
+  mutex_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
   bitmap_write (free_map, free_map_file);
-  lock_release (&free_map_lock);
+  mutex_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -7,6 +7,7 @@
 #include "filesys/free-map.h"
 #include "filesys/buffer-cache.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include <stdio.h>
 
 /* Identifies an inode. */
@@ -45,6 +46,7 @@ static int inode_extend_length (block_sector_t inode_sector, size_t lengh);
 static void inode_sector_remove (struct inode *inode);
 static bool inode_extend_sectors (block_sector_t inode_sector, int num);
 static int inode_extend_sector (block_sector_t sector, off_t sector_ofs);
+static void end_write (struct inode *);
 
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -63,9 +65,13 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    int writer_cnt;                     /* Writes in progress. */
     struct lock inode_lock;             /* Guard inode. */
-    struct lock inode_length_lock;      /* Guard inode length. */
+    struct rwlock data_lock;            /* Readers share, writers and
+                                           extenders exclusive. */
+    struct rwlock dir_lock;             /* Guard directory entries. */
     int is_dir;                         /* file type. */
+    struct load_plan *load_plan;        /* Cached by load(), or null. */
   };
 
 
@@ -398,12 +404,30 @@ inode_sector_release (block_sector_t sector, int begin, int end, int level)
 static struct list open_inodes;
 static struct lock open_inodes_lock;
 
+/* Cache of `struct inode'.  An inode's locks are initialized
+   once, when its slab is created, and are free whenever the
+   inode is not in use. */
+static struct kmem_cache *inode_cache;
+
+/* Initializes the locks of INODE_, a new `struct inode'. */
+static void
+inode_ctor (void *inode_)
+{
+  struct inode *inode = inode_;
+
+  lock_init (&inode->inode_lock);
+  rwlock_init (&inode->data_lock);
+  rwlock_init (&inode->dir_lock);
+}
+
 /* Initializes the inode module. */
 void
 inode_init (void)
 {
   list_init (&open_inodes);
   lock_init (&open_inodes_lock);
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode), 0,
+                                   inode_ctor);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -466,7 +490,7 @@ inode_open (block_sector_t sector)
   lock_release (&open_inodes_lock);
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
     return NULL;
 
@@ -477,9 +501,9 @@ inode_open (block_sector_t sector)
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
+  inode->writer_cnt = 0;
   inode->removed = false;
-  lock_init (&inode->inode_lock);
-  lock_init (&inode->inode_length_lock);
+  inode->load_plan = NULL;
   cache_get (fs_device, sector,
              offsetof (struct inode_disk, is_dir),
              &inode->is_dir,
@@ -499,6 +523,55 @@ inode_reopen (struct inode *inode)
   return inode;
 }
 
+/* Returns the lock guarding the entries of directory INODE.
+   Lookups hold it for reading, changes for writing. */
+struct rwlock *
+inode_dir_lock (struct inode *inode)
+{
+  ASSERT (is_inode_dir (inode));
+  return &inode->dir_lock;
+}
+
+/* Returns the load plan that load() cached for executable INODE,
+   or a null pointer if there is none.  The plan stays valid as
+   long as the caller keeps writes to INODE denied. */
+struct load_plan *
+inode_get_load_plan (struct inode *inode)
+{
+  struct load_plan *plan;
+
+  lock_acquire (&inode->inode_lock);
+  plan = inode->load_plan;
+  lock_release (&inode->inode_lock);
+  return plan;
+}
+
+/* Caches PLAN, which must have been allocated with malloc(), as
+   INODE's load plan, unless another thread got there first.
+   Returns the plan INODE ends up with; if that is not PLAN, the
+   caller must free PLAN.  The plan is freed when INODE is
+   written to or closed for the last time.
+
+   A write that began before writes to INODE were denied may
+   still be changing the data PLAN was read from, so while one is
+   in progress nothing is cached and a null pointer is returned.
+   The caller must then free PLAN itself when done with it. */
+struct load_plan *
+inode_set_load_plan (struct inode *inode, struct load_plan *plan)
+{
+  lock_acquire (&inode->inode_lock);
+  if (inode->writer_cnt > 0)
+    plan = NULL;
+  else
+    {
+      if (inode->load_plan == NULL)
+        inode->load_plan = plan;
+      plan = inode->load_plan;
+    }
+  lock_release (&inode->inode_lock);
+  return plan;
+}
+
 /* Returns INODE's inode number. */
 block_sector_t
 inode_get_inumber (const struct inode *inode)
@@ -535,7 +608,8 @@ inode_close (struct inode *inode)
         }
 
       lock_release (&inode->inode_lock);
-      free (inode);
+      free (inode->load_plan);
+      kmem_cache_free (inode_cache, inode);
     } else {
       lock_release (&inode->inode_lock);
       lock_release (&open_inodes_lock);
@@ -574,18 +648,15 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
 
+  rwlock_acquire_read (&inode->data_lock);
   while (size > 0)
     {
       /* Disk sector to read, starting byte offset within sector. */
-      lock_acquire (&inode->inode_length_lock);
       block_sector_t sector_idx = byte_to_sector (inode, offset);
-      lock_release (&inode->inode_length_lock);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      lock_acquire (&inode->inode_length_lock);
       off_t inode_left = inode_length (inode) - offset;
-      lock_release (&inode->inode_length_lock);
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
@@ -602,6 +673,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       offset += chunk_size;
       bytes_read += chunk_size;
     }
+  rwlock_release_read (&inode->data_lock);
 
   return bytes_read;
 }
@@ -617,27 +689,43 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  int new_length = inode_length (inode); 
+  int new_length;
   int extend_length = 0;
 
+  /* The write may change an executable's headers, so it drops
+     the cached load plan.  Doing so in the same step as checking
+     for denied writes keeps it from freeing a plan that load()
+     got after denying writes.  Until the write is done,
+     inode_set_load_plan() caches no new plan, which might have
+     been read from the data as it was before the write. */
+  lock_acquire (&inode->inode_lock);
   if (inode->deny_write_cnt)
-    return 0;
+    {
+      lock_release (&inode->inode_lock);
+      return 0;
+    }
+  free (inode->load_plan);
+  inode->load_plan = NULL;
+  inode->writer_cnt++;
+  lock_release (&inode->inode_lock);
 
-  lock_acquire (&inode->inode_length_lock);
-  if (new_length != inode_length (inode)) {
-    return inode_write_at (inode, buffer_, size, offset);
-  }
+  rwlock_acquire_write (&inode->data_lock);
+  new_length = inode_length (inode);
 
-  off_t inode_left = inode_length (inode) - offset;
+  off_t inode_left = new_length - offset;
   if (inode_left < 0) {
     if ((extend_length = inode_extend_length (inode->sector, -inode_left + size))
         != size - inode_left) {
+      rwlock_release_write (&inode->data_lock);
+      end_write (inode);
       return 0;
     }
     new_length += extend_length;
   } else if (size - inode_left > 0) {
     if ((extend_length = inode_extend_length (inode->sector, size - inode_left))
         != size - inode_left) {
+      rwlock_release_write (&inode->data_lock);
+      end_write (inode);
       return 0;
     }
     new_length += extend_length;
@@ -678,17 +766,29 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
              offsetof (struct inode_disk, length),
              &new_length, sizeof(int));
 
-  lock_release (&inode->inode_length_lock);
+  rwlock_release_write (&inode->data_lock);
+  end_write (inode);
   return bytes_written;
 }
 
+/* Marks a write to INODE begun by inode_write_at() as done. */
+static void
+end_write (struct inode *inode)
+{
+  lock_acquire (&inode->inode_lock);
+  inode->writer_cnt--;
+  lock_release (&inode->inode_lock);
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
 inode_deny_write (struct inode *inode)
 {
+  lock_acquire (&inode->inode_lock);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  lock_release (&inode->inode_lock);
 }
 
 /* Re-enables writes to INODE.
@@ -697,9 +797,11 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode)
 {
+  lock_acquire (&inode->inode_lock);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  lock_release (&inode->inode_lock);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
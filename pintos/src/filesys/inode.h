@@ -6,6 +6,8 @@
 #include "devices/block.h"
 
 struct bitmap;
+struct rwlock;
+struct load_plan;
 
 void inode_init (void);
 bool inode_create (block_sector_t, off_t, bool);
@@ -22,5 +24,8 @@ off_t inode_length (const struct inode *);
 off_t inode_size (const struct inode *);
 bool is_inode_dir (const struct inode *);
 int inode_open_cnt (const struct inode *);
+struct rwlock *inode_dir_lock (struct inode *);
+struct load_plan *inode_get_load_plan (struct inode *);
+struct load_plan *inode_set_load_plan (struct inode *, struct load_plan *);
 
 #endif /* filesys/inode.h */
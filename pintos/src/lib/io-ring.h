@@ -0,0 +1,66 @@
+#ifndef __LIB_IO_RING_H
+#define __LIB_IO_RING_H
+
+#include <stdint.h>
+
+/* Ring for submitting system calls in batches.
+
+   A process keeps a `struct io_ring', initially all zeros, in
+   its own memory.  To queue an operation, it fills in the
+   submission entry at index SQ_TAIL and increments SQ_TAIL.
+   Then one io_ring_enter() call (SYS_ENTER) has the kernel carry
+   out up to TO_SUBMIT queued operations, in order.  For each
+   one, the kernel increments SQ_HEAD and posts the result in the
+   completion entry at index CQ_TAIL, incrementing CQ_TAIL.  The
+   process consumes completions by incrementing CQ_HEAD.
+
+   Indexes count up freely and are taken modulo IO_RING_ENTRIES.
+   The kernel stops early if the completion queue fills up, so a
+   process should reap completions before submitting more than
+   there is room for. */
+
+/* Number of entries in each queue.  A power of 2. */
+#define IO_RING_ENTRIES 32
+
+/* Operations. */
+enum io_ring_op
+  {
+    IO_OP_NOP,                  /* Does nothing; result is 0. */
+    IO_OP_READ,                 /* read (FD, BUF, LEN). */
+    IO_OP_WRITE,                /* write (FD, BUF, LEN). */
+    IO_OP_PREAD,                /* pread (FD, BUF, LEN, OFFSET). */
+    IO_OP_PWRITE,               /* pwrite (FD, BUF, LEN, OFFSET). */
+    IO_OP_OPEN,                 /* open (BUF). */
+    IO_OP_CLOSE                 /* close (FD); result is 0. */
+  };
+
+/* A submission queue entry. */
+struct io_sqe
+  {
+    uint32_t opcode;            /* One of enum io_ring_op. */
+    int32_t fd;                 /* File descriptor. */
+    void *buf;                  /* Buffer, or file name to open. */
+    uint32_t len;               /* Buffer size in bytes. */
+    uint32_t offset;            /* File offset for pread and pwrite. */
+    uint32_t user_data;         /* Passed through to completion. */
+  };
+
+/* A completion queue entry. */
+struct io_cqe
+  {
+    uint32_t user_data;         /* From the submission entry. */
+    int32_t res;                /* What the system call returned. */
+  };
+
+/* A submission and completion ring. */
+struct io_ring
+  {
+    uint32_t sq_head;           /* Next entry the kernel takes. */
+    uint32_t sq_tail;           /* Next entry the process fills. */
+    uint32_t cq_head;           /* Next completion the process reaps. */
+    uint32_t cq_tail;           /* Next completion the kernel posts. */
+    struct io_sqe sqes[IO_RING_ENTRIES];
+    struct io_cqe cqes[IO_RING_ENTRIES];
+  };
+
+#endif /* lib/io-ring.h */
@@ -1,122 +1,119 @@
 #include <console.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/serial.h"
 #include "devices/vga.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 
-static void vprintf_helper (char, void *);
-static void putchar_have_lock (uint8_t c);
-
-/* The console lock.
-   Both the vga and serial layers do their own locking, so it's
-   safe to call them at any time.
-   But this lock is useful to prevent simultaneous printf() calls
-   from mixing their output, which looks confusing. */
-static struct lock console_lock;
-
-/* True in ordinary circumstances: we want to use the console
-   lock to avoid mixing output between threads, as explained
-   above.
-
-   False in early boot before the point that locks are functional
-   or the console lock has been initialized, or after a kernel
-   panics.  In the former case, taking the lock would cause an
-   assertion failure, which in turn would cause a panic, turning
-   it into the latter case.  In the latter case, if it is a buggy
-   lock_acquire() implementation that caused the panic, we'll
-   likely just recurse. */
-static bool use_console_lock;
-
-/* It's possible, if you add enough debug output to Pintos, to
-   try to recursively grab console_lock from a single thread.  As
-   a real example, I added a printf() call to palloc_free().
-   Here's a real backtrace that resulted:
-
-   lock_console()
-   vprintf()
-   printf()               - palloc() tries to grab the lock again
-   palloc_free()
-   thread_schedule_tail() - another thread dying as we switch threads
-   schedule()
-   thread_yield()
-   intr_handler()         - timer interrupt
-   intr_set_level()
-   serial_putc()
-   putchar_have_lock()
-   putbuf()
-   sys_write()            - one process writing to the console
-   syscall_handler()
-   intr_handler()
-
-   This kind of thing is very difficult to debug, so we avoid the
-   problem by simulating a recursive lock with a depth
-   counter. */
-static int console_lock_depth;
+/* Console output buffer.
+
+   Writers copy their output into OBUF, a ring buffer, and
+   return.  The console thread writes it out to the vga display
+   and serial port in the background, so a writer no longer
+   waits for the serial port, nor for another writer to finish
+   waiting for it.
+
+   There is no lock.  A writer reserves room for all of its
+   output and copies it in with interrupts turned off, which on
+   a uniprocessor is all it takes to keep writers from mixing
+   their output: each putbuf() comes out in one piece, and so
+   does each printf() of up to PRINTF_CHUNK bytes.  Only a
+   writer that finds OBUF full waits, for the console thread to
+   make room.
+
+   OBUF is written out directly, by whichever thread is writing,
+   before the console thread starts and after a kernel panics.
+   It is also written out directly when OBUF is full and the
+   writer cannot wait: in an interrupt handler or with interrupts
+   turned off. */
+#define OBUF_SIZE 4096                  /* Power of 2. */
+static char obuf[OBUF_SIZE];
+static size_t obuf_head;                /* Bytes ever added to OBUF. */
+static size_t obuf_tail;                /* Bytes ever taken from OBUF. */
+
+/* Most bytes the console thread takes from OBUF at once. */
+#define DRAIN_BATCH 64
+
+/* vprintf() output is added to OBUF in pieces of this size. */
+#define PRINTF_CHUNK 128
+
+/* True while the console thread writes out OBUF.  False in
+   early boot, before it has started, and after a kernel
+   panic. */
+static bool buffered;
+
+/* Synchronization with the console thread, with interrupts
+   off. */
+static struct semaphore obuf_ready;     /* Upped when OBUF fills. */
+static bool drainer_idle;               /* Console thread waiting? */
+static struct semaphore obuf_room;      /* Upped when OBUF drains. */
+static int room_waiters;                /* Writers waiting for room. */
 
 /* Number of characters written to console. */
 static int64_t write_cnt;
 
-/* Enable console locking. */
+/* Auxiliary data for vprintf_helper(). */
+struct vprintf_aux
+  {
+    char buf[PRINTF_CHUNK];             /* Output not yet in OBUF. */
+    size_t len;                         /* Bytes in BUF. */
+    int char_cnt;                       /* Characters formatted. */
+  };
+
+static void vprintf_helper (char, void *);
+static void obuf_write (const char *, size_t);
+static void obuf_drain (void);
+static void console_putc (uint8_t);
+static thread_func console_thread NO_RETURN;
+
+/* Initializes the console output buffer. */
 void
 console_init (void)
 {
-  lock_init (&console_lock);
-  use_console_lock = true;
+  sema_init (&obuf_ready, 0);
+  sema_init (&obuf_room, 0);
 }
 
-/* Notifies the console that a kernel panic is underway,
-   which warns it to avoid trying to take the console lock from
-   now on. */
+/* Starts the console thread, after which console output is
+   buffered.  The thread scheduler must be running. */
 void
-console_panic (void)
+console_start (void)
 {
-  use_console_lock = false;
+  if (thread_create ("console", PRI_DEFAULT, console_thread, NULL)
+      == TID_ERROR)
+    PANIC ("console: thread creation failed");
+  buffered = true;
 }
 
-/* Prints console statistics. */
+/* Writes out all the output buffered so far. */
 void
-console_print_stats (void)
+console_flush (void)
 {
-  printf ("Console: %lld characters output\n", write_cnt);
+  enum intr_level old_level = intr_disable ();
+  obuf_drain ();
+  intr_set_level (old_level);
 }
 
-/* Acquires the console lock. */
-static void
-acquire_console (void)
-{
-  if (!intr_context () && use_console_lock)
-    {
-      if (lock_held_by_current_thread (&console_lock))
-        console_lock_depth++;
-      else
-        lock_acquire (&console_lock);
-    }
-}
-
-/* Releases the console lock. */
-static void
-release_console (void)
+/* Notifies the console that a kernel panic is underway, so that
+   it writes out the output buffered so far and from now on
+   writes output directly, without waiting for the console
+   thread, which might never run again. */
+void
+console_panic (void)
 {
-  if (!intr_context () && use_console_lock)
-    {
-      if (console_lock_depth > 0)
-        console_lock_depth--;
-      else
-        lock_release (&console_lock);
-    }
+  buffered = false;
+  console_flush ();
 }
 
-/* Returns true if the current thread has the console lock,
-   false otherwise. */
-static bool
-console_locked_by_current_thread (void)
+/* Prints console statistics. */
+void
+console_print_stats (void)
 {
-  return (intr_context ()
-          || !use_console_lock
-          || lock_held_by_current_thread (&console_lock));
+  printf ("Console: %lld characters output\n", write_cnt);
 }
 
 /* The standard vprintf() function,
@@ -125,13 +122,15 @@ console_locked_by_current_thread (void)
 int
 vprintf (const char *format, va_list args)
 {
-  int char_cnt = 0;
+  struct vprintf_aux aux;
 
-  acquire_console ();
-  __vprintf (format, args, vprintf_helper, &char_cnt);
-  release_console ();
+  aux.len = 0;
+  aux.char_cnt = 0;
+  __vprintf (format, args, vprintf_helper, &aux);
+  if (aux.len > 0)
+    obuf_write (aux.buf, aux.len);
 
-  return char_cnt;
+  return aux.char_cnt;
 }
 
 /* Writes string S to the console, followed by a new-line
@@ -139,11 +138,15 @@ vprintf (const char *format, va_list args)
 int
 puts (const char *s)
 {
-  acquire_console ();
+  struct vprintf_aux aux;
+
+  aux.len = 0;
+  aux.char_cnt = 0;
   while (*s != '\0')
-    putchar_have_lock (*s++);
-  putchar_have_lock ('\n');
-  release_console ();
+    vprintf_helper (*s++, &aux);
+  vprintf_helper ('\n', &aux);
+  if (aux.len > 0)
+    obuf_write (aux.buf, aux.len);
 
   return 0;
 }
@@ -152,40 +155,219 @@ puts (const char *s)
 void
 putbuf (const char *buffer, size_t n)
 {
-  acquire_console ();
-  while (n-- > 0)
-    putchar_have_lock (*buffer++);
-  release_console ();
+  if (n > 0)
+    obuf_write (buffer, n);
 }
 
 /* Writes C to the vga display and serial port. */
 int
 putchar (int c)
 {
-  acquire_console ();
-  putchar_have_lock (c);
-  release_console ();
+  char ch = c;
+
+  obuf_write (&ch, 1);
 
   return c;
 }
-
+
+/* Writes the N characters in BUFFER to the console through LINE,
+   which holds back an incomplete line at the end of BUFFER until
+   a later call completes it.  Each complete line comes out in
+   one piece, so the lines of writers that use lines of their own
+   do not mix, even if they write a piece of a line at a time.  A
+   line longer than CONSOLE_LINE_MAX bytes comes out in pieces of
+   that size. */
+void
+putbuf_line (struct console_line *line, const char *buffer, size_t n)
+{
+  size_t complete;
+
+  /* Write out everything through the last new-line, together
+     with the start of the first line from earlier calls. */
+  for (complete = n; complete > 0; complete--)
+    if (buffer[complete - 1] == '\n')
+      break;
+  if (complete > 0)
+    {
+      if (line->len == 0)
+        putbuf (buffer, complete);
+      else if (line->len + complete <= sizeof line->buf)
+        {
+          memcpy (line->buf + line->len, buffer, complete);
+          putbuf (line->buf, line->len + complete);
+        }
+      else
+        {
+          putbuf (line->buf, line->len);
+          putbuf (buffer, complete);
+        }
+      line->len = 0;
+      buffer += complete;
+      n -= complete;
+    }
+
+  /* Hold back the rest. */
+  while (n > 0)
+    {
+      size_t chunk = sizeof line->buf - line->len;
+      if (chunk > n)
+        chunk = n;
+      memcpy (line->buf + line->len, buffer, chunk);
+      line->len += chunk;
+      buffer += chunk;
+      n -= chunk;
+
+      if (line->len == sizeof line->buf)
+        console_line_flush (line);
+    }
+}
+
+/* Writes out the incomplete line held back in LINE, if any. */
+void
+console_line_flush (struct console_line *line)
+{
+  putbuf (line->buf, line->len);
+  line->len = 0;
+}
+
 /* Helper function for vprintf(). */
 static void
-vprintf_helper (char c, void *char_cnt_)
+vprintf_helper (char c, void *aux_)
+{
+  struct vprintf_aux *aux = aux_;
+
+  aux->char_cnt++;
+  aux->buf[aux->len++] = c;
+  if (aux->len == sizeof aux->buf)
+    {
+      obuf_write (aux->buf, aux->len);
+      aux->len = 0;
+    }
+}
+
+/* Adds the N characters in BUFFER to OBUF all at once, if they
+   fit in it, and lets the console thread know.  Waits for room
+   if OBUF is full, or writes out OBUF if waiting is not
+   possible.  Without the console thread, writes out OBUF and
+   BUFFER directly. */
+static void
+obuf_write (const char *buffer, size_t n)
+{
+  enum intr_level old_level = intr_disable ();
+
+  write_cnt += n;
+  if (!buffered)
+    {
+      obuf_drain ();
+      while (n-- > 0)
+        console_putc (*buffer++);
+      intr_set_level (old_level);
+      return;
+    }
+
+  while (n > 0)
+    {
+      size_t chunk = n < OBUF_SIZE ? n : OBUF_SIZE;
+      size_t ofs, first;
+
+      if (OBUF_SIZE - (obuf_head - obuf_tail) < chunk)
+        {
+          if (old_level == INTR_ON && !intr_context ())
+            {
+              room_waiters++;
+              sema_down (&obuf_room);
+            }
+          else
+            obuf_drain ();
+          continue;
+        }
+
+      ofs = obuf_head % OBUF_SIZE;
+      first = OBUF_SIZE - ofs < chunk ? OBUF_SIZE - ofs : chunk;
+      memcpy (obuf + ofs, buffer, first);
+      memcpy (obuf, buffer + first, chunk - first);
+      obuf_head += chunk;
+      buffer += chunk;
+      n -= chunk;
+    }
+
+  if (drainer_idle)
+    {
+      drainer_idle = false;
+      sema_up (&obuf_ready);
+    }
+  intr_set_level (old_level);
+}
+
+/* Wakes up the writers waiting for room in OBUF.  Interrupts
+   must be off. */
+static void
+wake_room_waiters (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (room_waiters > 0)
+    {
+      room_waiters--;
+      sema_up (&obuf_room);
+    }
+}
+
+/* Writes out everything in OBUF directly.  Interrupts must be
+   off. */
+static void
+obuf_drain (void)
 {
-  int *char_cnt = char_cnt_;
-  (*char_cnt)++;
-  putchar_have_lock (c);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (obuf_tail != obuf_head)
+    console_putc (obuf[obuf_tail++ % OBUF_SIZE]);
+  wake_room_waiters ();
+}
+
+/* Console thread.  Takes output from OBUF a batch at a time and
+   hands it to the serial port, which sends it in the background,
+   and to the vga display.  A batch is taken and handed over with
+   interrupts off, after waiting for room for it in the serial
+   transmit queue, so no output is ever out of OBUF without being
+   in the queue, where console_flush() and serial_flush() would
+   miss it. */
+static void
+console_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      char batch[DRAIN_BATCH];
+      size_t n, i;
+      enum intr_level old_level;
+
+      old_level = intr_disable ();
+      while (obuf_tail == obuf_head)
+        {
+          drainer_idle = true;
+          sema_down (&obuf_ready);
+        }
+      serial_wait_room (sizeof batch);
+
+      /* OBUF may have been written out while we waited. */
+      n = obuf_head - obuf_tail;
+      if (n > sizeof batch)
+        n = sizeof batch;
+      for (i = 0; i < n; i++)
+        batch[i] = obuf[obuf_tail++ % OBUF_SIZE];
+      serial_putbuf (batch, n);
+      for (i = 0; i < n; i++)
+        vga_putc (batch[i]);
+      wake_room_waiters ();
+      intr_set_level (old_level);
+    }
 }
 
-/* Writes C to the vga display and serial port.
-   The caller has already acquired the console lock if
-   appropriate. */
+/* Writes C to the vga display and serial port.  Both do their
+   own locking, so it is safe to call them at any time. */
 static void
-putchar_have_lock (uint8_t c)
+console_putc (uint8_t c)
 {
-  ASSERT (console_locked_by_current_thread ());
-  write_cnt++;
   serial_putc (c);
   vga_putc (c);
 }
@@ -1,8 +1,26 @@
 #ifndef __LIB_KERNEL_CONSOLE_H
 #define __LIB_KERNEL_CONSOLE_H
 
+#include <stddef.h>
+
+/* Longest line held back by a console_line. */
+#define CONSOLE_LINE_MAX 128
+
+/* The start of a line of console output, held back until the
+   rest of the line is written.  See putbuf_line(). */
+struct console_line
+  {
+    size_t len;                         /* Bytes in BUF. */
+    char buf[CONSOLE_LINE_MAX];         /* Incomplete line. */
+  };
+
 void console_init (void);
+void console_start (void);
+void console_flush (void);
 void console_panic (void);
 void console_print_stats (void);
 
+void putbuf_line (struct console_line *, const char *, size_t);
+void console_line_flush (struct console_line *);
+
 #endif /* lib/kernel/console.h */
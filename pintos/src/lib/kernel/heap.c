@@ -0,0 +1,212 @@
+/* Pairing heap.
+
+   See heap.h for basic information. */
+
+#include "heap.h"
+#include "../debug.h"
+
+/* Returns true if A belongs above B in heap H: A is greater, or
+   equal and inserted earlier. */
+static bool
+above (const struct heap *h, const struct heap_elem *a,
+       const struct heap_elem *b)
+{
+  if (h->less (b, a, h->aux))
+    return true;
+  else if (h->less (a, b, h->aux))
+    return false;
+  else
+    return (int) (a->seq - b->seq) < 0;
+}
+
+/* Melds the trees rooted at A and B, either of which may be
+   null, and returns the root of the result.  A and B must not
+   have siblings. */
+static struct heap_elem *
+meld (const struct heap *h, struct heap_elem *a, struct heap_elem *b)
+{
+  struct heap_elem *t;
+
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+  if (above (h, b, a))
+    {
+      t = a;
+      a = b;
+      b = t;
+    }
+
+  /* Make B the first child of A. */
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  a->child = b;
+  a->prev = NULL;
+  return a;
+}
+
+/* Melds the sibling list starting at FIRST into a single tree,
+   first left to right in pairs, then the pairs right to left,
+   and returns its root. */
+static struct heap_elem *
+merge_pairs (const struct heap *h, struct heap_elem *first)
+{
+  struct heap_elem *pairs = NULL;
+  struct heap_elem *root = NULL;
+
+  while (first != NULL)
+    {
+      struct heap_elem *a = first;
+      struct heap_elem *b = a->next;
+
+      first = b != NULL ? b->next : NULL;
+      a->next = a->prev = NULL;
+      if (b != NULL)
+        b->next = b->prev = NULL;
+
+      a = meld (h, a, b);
+      a->next = pairs;
+      pairs = a;
+    }
+
+  while (pairs != NULL)
+    {
+      struct heap_elem *next = pairs->next;
+      pairs->next = NULL;
+      root = meld (h, root, pairs);
+      pairs = next;
+    }
+  return root;
+}
+
+/* Unlinks E, which is not the root, from its parent and
+   siblings.  E keeps its children. */
+static void
+detach (struct heap_elem *e)
+{
+  if (e->prev->child == e)
+    e->prev->child = e->next;
+  else
+    e->prev->next = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+  e->next = e->prev = NULL;
+}
+
+/* Removes E from H without touching its insertion number. */
+static void
+remove_elem (struct heap *h, struct heap_elem *e)
+{
+  struct heap_elem *children = e->child;
+
+  if (e == h->root)
+    h->root = merge_pairs (h, children);
+  else
+    {
+      detach (e);
+      h->root = meld (h, h->root, merge_pairs (h, children));
+    }
+  e->child = e->next = e->prev = NULL;
+}
+
+/* Initializes H as an empty heap ordered by LESS given auxiliary
+   data AUX. */
+void
+heap_init (struct heap *h, heap_less_func *less, void *aux)
+{
+  ASSERT (h != NULL);
+  ASSERT (less != NULL);
+
+  h->root = NULL;
+  h->elem_cnt = 0;
+  h->seq = 0;
+  h->less = less;
+  h->aux = aux;
+}
+
+/* Inserts E into H. */
+void
+heap_push (struct heap *h, struct heap_elem *e)
+{
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+
+  e->child = e->next = e->prev = NULL;
+  e->seq = h->seq++;
+  h->root = meld (h, h->root, e);
+  h->elem_cnt++;
+}
+
+/* Returns the greatest element in H, which must not be empty.
+   Of several equal elements, returns the one inserted first. */
+struct heap_elem *
+heap_top (const struct heap *h)
+{
+  ASSERT (!heap_empty (h));
+  return h->root;
+}
+
+/* Removes and returns the greatest element in H, which must not
+   be empty. */
+struct heap_elem *
+heap_pop (struct heap *h)
+{
+  struct heap_elem *top = heap_top (h);
+
+  remove_elem (h, top);
+  h->elem_cnt--;
+  return top;
+}
+
+/* Removes E, which must be in H, from H. */
+void
+heap_remove (struct heap *h, struct heap_elem *e)
+{
+  ASSERT (!heap_empty (h));
+
+  remove_elem (h, e);
+  h->elem_cnt--;
+}
+
+/* Restores H's order after the value of E, which is in H, has
+   increased or stayed the same. */
+void
+heap_increase (struct heap *h, struct heap_elem *e)
+{
+  ASSERT (!heap_empty (h));
+
+  if (e != h->root)
+    {
+      detach (e);
+      h->root = meld (h, h->root, e);
+    }
+}
+
+/* Restores H's order after the value of E, which is in H, has
+   changed in either direction.  E keeps its place among equal
+   elements. */
+void
+heap_update (struct heap *h, struct heap_elem *e)
+{
+  ASSERT (!heap_empty (h));
+
+  remove_elem (h, e);
+  h->root = meld (h, h->root, e);
+}
+
+/* Returns the number of elements in H. */
+size_t
+heap_size (const struct heap *h)
+{
+  return h->elem_cnt;
+}
+
+/* Returns true if H is empty, false otherwise. */
+bool
+heap_empty (const struct heap *h)
+{
+  return h->root == NULL;
+}
@@ -20,7 +20,7 @@ enum
     SYS_CLOSE,                  /* Close a file. */
     SYS_PRACTICE,               /* Returns arg incremented by 1 */
 
-    /* Unused. */
+    /* Project 3 and optionally project 4. */
     SYS_MMAP,                   /* Map a file into memory. */
     SYS_MUNMAP,                 /* Remove a memory mapping. */
 
@@ -34,7 +34,25 @@ enum
     SYS_CACHE_FLUSH,            /* Flush buffer cache.*/
     SYS_CACHE_STAT,             /* Returns the buffer cache stat. */
     SYS_BRCNT,                  /* Returns the block read cnt. */
-    SYS_BWCNT                   /* Returns the block write cnt. */
+    SYS_BWCNT,                  /* Returns the block write cnt. */
+
+    SYS_SCHED_DUMP,             /* Prints the scheduler trace. */
+
+    /* Memory project. */
+    SYS_SBRK,                   /* Moves the heap break. */
+
+    /* Vectored and positioned I/O. */
+    SYS_READV,                  /* Read from a file into several buffers. */
+    SYS_WRITEV,                 /* Write to a file from several buffers. */
+    SYS_PREAD,                  /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+
+    /* Batched system calls. */
+    SYS_ENTER,                  /* Carry out operations queued in a ring. */
+
+    /* Process creation. */
+    SYS_SPAWN,                  /* Start a process with given argv and files. */
+    SYS_WAIT_ANY                /* Wait for any child process to die. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,31 @@
+#ifndef __LIB_SYSCALL_TYPES_H
+#define __LIB_SYSCALL_TYPES_H
+
+#include <stddef.h>
+
+/* Structures and limits that system calls share between user
+   programs and the kernel. */
+
+/* One buffer of a readv() or writev(). */
+struct iovec
+  {
+    void *iov_base;             /* Start of buffer. */
+    size_t iov_len;             /* Size of buffer in bytes. */
+  };
+
+/* Maximum number of buffers in a readv() or writev(). */
+#define IOV_MAX 1024
+
+/* A file for spawn() to give the new process: the file open as
+   PARENT_FD in the caller is opened again as CHILD_FD in the new
+   process.  CHILD_FD may not be a console descriptor. */
+struct spawn_action
+  {
+    int parent_fd;              /* Descriptor in the caller. */
+    int child_fd;               /* Descriptor in the new process. */
+  };
+
+/* Maximum number of actions in a spawn(). */
+#define SPAWN_ACTIONS_MAX 16
+
+#endif /* lib/syscall-types.h */
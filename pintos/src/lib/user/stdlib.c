@@ -1,25 +1,422 @@
 #include <stdlib.h>
+#include <debug.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
 
-void*
-malloc (size_t size)
+/* User heap allocator.
+
+   Memory comes from the heap break, which sbrk() moves.  The
+   heap is a sequence of blocks.  Each block starts with a
+   one-word header that holds its size and two flags.  The size
+   is a multiple of ALIGNMENT and includes the header.  The flags
+   say whether the block is in use and whether the block just
+   before it is.  A free block also repeats its size in a footer
+   in its last word.  When a block is freed, the footer lets it
+   find and merge with a free block before it, and the header
+   after it tells whether the next block is free.  These are the
+   "boundary tags".  The heap ends with a header of size 0, the
+   epilogue, marked in use so that nothing ever merges with it.
+
+   Free blocks are kept in size classes, one per power of 2.
+   malloc() first looks for a block big enough within the
+   request's own class.  Failing that, it takes the first block
+   of the next nonempty larger class, which is always big enough.
+   Only if every class is empty does it move the break.  A free
+   block at the end of the heap grows when the break moves, and
+   so does a block that realloc() grows in place.  A free block
+   of at least TRIM_THRESHOLD bytes at the end of the heap is
+   given back to the system. */
+
+/* Block alignment and sizes. */
+#define ALIGNMENT 8                     /* Payload alignment. */
+#define HDR_SIZE sizeof (size_t)        /* Header size. */
+#define MIN_BLOCK (sizeof (struct block) + sizeof (size_t)) /* With footer. */
+
+/* Header flags. */
+#define IN_USE 1                        /* Block is allocated. */
+#define PREV_IN_USE 2                   /* Previous block is allocated. */
+#define FLAGS (ALIGNMENT - 1)
+
+/* Number of size classes, one per bit of a block size. */
+#define CLASS_CNT (sizeof (size_t) * 8)
+
+/* A free block at the end of the heap at least this big is
+   returned to the system. */
+#define TRIM_THRESHOLD (64 * 1024)
+
+/* A block.  Only the header is valid for blocks in use; their
+   payload starts where NEXT would be. */
+struct block
+  {
+    size_t hdr;                         /* Size and flags. */
+    struct block *next;                 /* Next in size class. */
+    struct block *prev;                 /* Previous in size class. */
+  };
+
+/* Free blocks, by size class. */
+static struct block *classes[CLASS_CNT];
+
+/* End of the heap, or null if the heap has not been set up. */
+static struct block *epilogue;
+
+/* Returns the size of block B. */
+static inline size_t
+block_size (const struct block *b)
 {
-  /* Homework 5, Part B: YOUR CODE HERE */
-  return NULL;
+  return b->hdr & ~(size_t) FLAGS;
 }
 
-void free (void* ptr)
+/* Returns the block following B. */
+static inline struct block *
+next_block (const struct block *b)
 {
-  /* Homework 5, Part B: YOUR CODE HERE */
+  return (struct block *) ((uint8_t *) b + block_size (b));
 }
 
-void* calloc (size_t nmemb, size_t size)
+/* Returns the block preceding B, which must be free. */
+static inline struct block *
+prev_block (const struct block *b)
 {
-  /* Homework 5, Part B: YOUR CODE HERE */
-  return NULL;
+  ASSERT (!(b->hdr & PREV_IN_USE));
+  return (struct block *) ((uint8_t *) b - ((const size_t *) b)[-1]);
+}
+
+/* Returns the block whose payload is PTR. */
+static inline struct block *
+payload_block (void *ptr)
+{
+  return (struct block *) ((uint8_t *) ptr - HDR_SIZE);
+}
+
+/* Returns the payload of block B. */
+static inline void *
+block_payload (struct block *b)
+{
+  return (uint8_t *) b + HDR_SIZE;
+}
+
+/* Returns the size of block needed for a SIZE-byte payload, or 0
+   if SIZE is too large. */
+static size_t
+block_size_for (size_t size)
+{
+  if (size > SIZE_MAX - HDR_SIZE - ALIGNMENT)
+    return 0;
+  size = ROUND_UP (size + HDR_SIZE, ALIGNMENT);
+  return size < MIN_BLOCK ? MIN_BLOCK : size;
+}
+
+/* Returns the size class of blocks of SIZE bytes: the position
+   of SIZE's most significant 1-bit. */
+static size_t
+size_class (size_t size)
+{
+  size_t class = 0;
+
+  while (size >>= 1)
+    class++;
+  return class;
+}
+
+/* Adds free block B to its size class. */
+static void
+class_insert (struct block *b)
+{
+  struct block **head = &classes[size_class (block_size (b))];
+
+  b->prev = NULL;
+  b->next = *head;
+  if (*head != NULL)
+    (*head)->prev = b;
+  *head = b;
+}
+
+/* Removes free block B from its size class. */
+static void
+class_remove (struct block *b)
+{
+  if (b->prev != NULL)
+    b->prev->next = b->next;
+  else
+    classes[size_class (block_size (b))] = b->next;
+  if (b->next != NULL)
+    b->next->prev = b->prev;
+}
+
+/* Makes B a free block of SIZE bytes, keeping its PREV_IN_USE
+   flag, and tells the next block.  Does not add B to a size
+   class. */
+static void
+mark_free (struct block *b, size_t size)
+{
+  b->hdr = size | (b->hdr & PREV_IN_USE);
+  ((size_t *) ((uint8_t *) b + size))[-1] = size;
+  next_block (b)->hdr &= ~(size_t) PREV_IN_USE;
+}
+
+/* Makes B a block of SIZE bytes in use, keeping its PREV_IN_USE
+   flag, and tells the next block. */
+static void
+mark_used (struct block *b, size_t size)
+{
+  b->hdr = size | (b->hdr & PREV_IN_USE) | IN_USE;
+  next_block (b)->hdr |= PREV_IN_USE;
+}
+
+/* Sets up an empty heap.  Returns true if successful, false if
+   the break cannot be moved. */
+static bool
+heap_init (void)
+{
+  uint8_t *base = sbrk (ALIGNMENT);
+
+  if (base == (void *) -1)
+    return false;
+
+  /* Headers sit just below ALIGNMENT boundaries, so that
+     payloads start on them. */
+  epilogue = (struct block *) (base + ALIGNMENT - HDR_SIZE);
+  epilogue->hdr = IN_USE | PREV_IN_USE;
+  return true;
 }
 
-void* realloc (void* ptr, size_t size)
+/* Moves the break to make a free block of at least SIZE bytes at
+   the end of the heap, growing the free block already there, if
+   any, and returns it, outside any size class.  Returns a null
+   pointer if the break cannot be moved. */
+static struct block *
+heap_extend (size_t size)
 {
-  /* Homework 5, Part B: YOUR CODE HERE */
+  struct block *b = epilogue;
+  size_t avail = 0;
+
+  if (!(epilogue->hdr & PREV_IN_USE))
+    {
+      b = prev_block (epilogue);
+      avail = block_size (b);
+      ASSERT (avail < size);
+    }
+
+  if (size - avail > INTPTR_MAX || sbrk (size - avail) == (void *) -1)
+    return NULL;
+  if (avail > 0)
+    class_remove (b);
+
+  epilogue = (struct block *) ((uint8_t *) b + size);
+  epilogue->hdr = IN_USE;
+  mark_free (b, size);
+  return b;
+}
+
+/* Gives back free block B, which is at the end of the heap and
+   outside any size class, to the system if it is large enough,
+   otherwise adds it to its size class. */
+static void
+heap_trim (struct block *b)
+{
+  size_t size = block_size (b);
+
+  if (size >= TRIM_THRESHOLD && sbrk (-(intptr_t) size) != (void *) -1)
+    {
+      b->hdr = (b->hdr & PREV_IN_USE) | IN_USE;
+      epilogue = b;
+    }
+  else
+    class_insert (b);
+}
+
+/* Removes and returns a free block of at least SIZE bytes from
+   the size classes, or returns a null pointer if there is
+   none. */
+static struct block *
+find_fit (size_t size)
+{
+  size_t class = size_class (size);
+  struct block *b;
+
+  for (b = classes[class]; b != NULL; b = b->next)
+    if (block_size (b) >= size)
+      {
+        class_remove (b);
+        return b;
+      }
+  for (class++; class < CLASS_CNT; class++)
+    if (classes[class] != NULL)
+      {
+        b = classes[class];
+        class_remove (b);
+        return b;
+      }
   return NULL;
 }
+
+/* Marks B, which is outside any size class, in use with SIZE
+   bytes, and frees what is left over if that is enough for a
+   block of its own. */
+static void
+place (struct block *b, size_t size)
+{
+  size_t excess = block_size (b) - size;
+
+  if (excess >= MIN_BLOCK)
+    {
+      struct block *rest;
+
+      /* Make the rest a block in use of its own and free it,
+         which merges it with the block after it if that is
+         free. */
+      b->hdr = size | (b->hdr & PREV_IN_USE) | IN_USE;
+      rest = next_block (b);
+      rest->hdr = excess | PREV_IN_USE | IN_USE;
+      free (block_payload (rest));
+    }
+  else
+    mark_used (b, block_size (b));
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size)
+{
+  struct block *b;
+
+  size = block_size_for (size);
+  if (size == 0)
+    return NULL;
+  if (epilogue == NULL && !heap_init ())
+    return NULL;
+
+  b = find_fit (size);
+  if (b == NULL)
+    b = heap_extend (size);
+  if (b == NULL)
+    return NULL;
+  place (b, size);
+  return block_payload (b);
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p)
+{
+  struct block *b, *next;
+  size_t size;
+
+  if (p == NULL)
+    return;
+
+  b = payload_block (p);
+  ASSERT (b->hdr & IN_USE);
+  size = block_size (b);
+
+  /* Merge with the free blocks on either side, if any. */
+  next = next_block (b);
+  if (!(next->hdr & IN_USE))
+    {
+      class_remove (next);
+      size += block_size (next);
+    }
+  if (!(b->hdr & PREV_IN_USE))
+    {
+      b = prev_block (b);
+      class_remove (b);
+      size += block_size (b);
+    }
+  mark_free (b, size);
+
+  if (next_block (b) == epilogue)
+    heap_trim (b);
+  else
+    class_insert (b);
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b)
+{
+  void *p;
+  size_t size;
+
+  /* Calculate block size and make sure it fits in size_t. */
+  size = a * b;
+  if (b != 0 && size / b != a)
+    return NULL;
+
+  /* Allocate and zero memory. */
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+
+  return p;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.  The block grows in place if the
+   block after it is free and big enough, or is the end of the
+   heap.  If successful, returns the new block; on failure,
+   returns a null pointer.  A call with null OLD_BLOCK is
+   equivalent to malloc(NEW_SIZE).  A call with zero NEW_SIZE is
+   equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size)
+{
+  struct block *b, *next;
+  size_t size, old_size;
+  void *new_block;
+
+  if (old_block == NULL)
+    return malloc (new_size);
+  if (new_size == 0)
+    {
+      free (old_block);
+      return NULL;
+    }
+
+  size = block_size_for (new_size);
+  if (size == 0)
+    return NULL;
+  b = payload_block (old_block);
+  old_size = block_size (b);
+
+  /* Grow in place into the free block after B... */
+  next = next_block (b);
+  if (size > old_size && !(next->hdr & IN_USE)
+      && old_size + block_size (next) >= size)
+    {
+      class_remove (next);
+      mark_used (b, old_size + block_size (next));
+      old_size = block_size (b);
+    }
+  /* ...or by moving the break, if B is at the end of the heap. */
+  else if (size > old_size && next == epilogue)
+    {
+      if (size - old_size > INTPTR_MAX
+          || sbrk (size - old_size) == (void *) -1)
+        return NULL;
+      epilogue = (struct block *) ((uint8_t *) b + size);
+      epilogue->hdr = IN_USE;
+      mark_used (b, size);
+      old_size = size;
+    }
+
+  if (size <= old_size)
+    {
+      /* Shrink in place, freeing the tail if it is big enough. */
+      place (b, size);
+      return old_block;
+    }
+
+  /* Move. */
+  new_block = malloc (new_size);
+  if (new_block == NULL)
+    return NULL;
+  memcpy (new_block, old_block, old_size - HDR_SIZE);
+  free (old_block);
+  return new_block;
+}
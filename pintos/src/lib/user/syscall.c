@@ -63,6 +63,25 @@
           retval;                                               \
         })
 
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; int $0x30; "      \
+             "addl $20, %%esp"                                  \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "r" (ARG3)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
 int
 practice (int i)
 {
@@ -194,8 +213,50 @@ inumber (int fd)
 void*
 sbrk (intptr_t increment)
 {
-  /* Homework 5, Part B: YOUR CODE HERE */
-  return NULL;
+  return (void *) syscall1 (SYS_SBRK, increment);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+io_ring_enter (struct io_ring *ring, unsigned to_submit)
+{
+  return syscall2 (SYS_ENTER, ring, to_submit);
+}
+
+pid_t
+spawn (const char *const argv[], const struct spawn_action *actions,
+       size_t action_cnt)
+{
+  return (pid_t) syscall3 (SYS_SPAWN, argv, actions, action_cnt);
+}
+
+pid_t
+wait_any (int *status)
+{
+  return (pid_t) syscall1 (SYS_WAIT_ANY, status);
 }
 
 void
@@ -221,3 +282,9 @@ brcnt (void)
 {
   return syscall0 (SYS_BRCNT);
 }
+
+void
+sched_dump (void)
+{
+  syscall0 (SYS_SCHED_DUMP);
+}
@@ -2,8 +2,11 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <debug.h>
+#include <io-ring.h>
+#include <syscall-types.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -50,10 +53,27 @@ int inumber (int fd);
 /* Homework 5, Part B. */
 void* sbrk (intptr_t increment);
 
+/* Vectored and positioned I/O. */
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+
+/* Batched system calls. */
+int io_ring_enter (struct io_ring *, unsigned to_submit);
+
+/* Process creation. */
+pid_t spawn (const char *const argv[], const struct spawn_action *,
+             size_t action_cnt);
+pid_t wait_any (int *status);
+
 /* buffer cache back end. */
 void cache_flush (void);
 void cache_stat (int *, int *, int *);
 unsigned long long bwcnt (void);
 unsigned long long brcnt (void);
 
+/* Scheduler tracing. */
+void sched_dump (void);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,21 @@
+/* Child process run by spawn-redirect and wait-any tests.
+
+   Writes its first command-line argument to file descriptor 10,
+   which its parent gave it, and exits with its argument
+   count. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-spawn";
+
+int
+main (int argc, char *argv[])
+{
+  if (argc != 2)
+    fail ("bad command-line arguments");
+  if (write (10, argv[1], strlen (argv[1])) != (int) strlen (argv[1]))
+    fail ("write to fd 10 failed");
+  return argc;
+}
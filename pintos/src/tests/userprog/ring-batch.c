@@ -0,0 +1,62 @@
+/* Queues writes, a positioned read, and a no-op in a system call
+   ring, submits them all with a single io_ring_enter(), and
+   checks the completions. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct io_ring ring;
+
+/* Queues an operation in RING. */
+static void
+queue (uint32_t opcode, int fd, void *buf, size_t len, size_t offset)
+{
+  struct io_sqe *sqe = &ring.sqes[ring.sq_tail % IO_RING_ENTRIES];
+
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->buf = buf;
+  sqe->len = len;
+  sqe->offset = offset;
+  sqe->user_data = ring.sq_tail;
+  ring.sq_tail++;
+}
+
+void
+test_main (void)
+{
+  char buf[sizeof sample];
+  size_t size = sizeof sample - 1;
+  int handle, done;
+  uint32_t i;
+
+  CHECK (create ("test.txt", size), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  queue (IO_OP_WRITE, handle, (char *) sample, 100, 0);
+  queue (IO_OP_WRITE, handle, (char *) sample + 100, size - 100, 0);
+  queue (IO_OP_PREAD, handle, buf, size, 0);
+  queue (IO_OP_NOP, 0, NULL, 0, 0);
+  done = io_ring_enter (&ring, 4);
+  if (done != 4)
+    fail ("io_ring_enter() returned %d instead of 4", done);
+  msg ("entered");
+
+  if (ring.sq_head != 4 || ring.cq_tail != 4)
+    fail ("sq_head %u, cq_tail %u instead of 4", ring.sq_head, ring.cq_tail);
+  for (i = 0; i < 4; i++)
+    {
+      static const int results[] = {100, sizeof sample - 101,
+                                    sizeof sample - 1, 0};
+      struct io_cqe *cqe = &ring.cqes[ring.cq_head++ % IO_RING_ENTRIES];
+      if (cqe->user_data != i || cqe->res != results[i])
+        fail ("completion %u: user_data %u, result %d", i,
+              cqe->user_data, cqe->res);
+    }
+  if (memcmp (buf, sample, size))
+    fail ("read back wrong data");
+  CHECK (tell (handle) == size, "tell");
+}
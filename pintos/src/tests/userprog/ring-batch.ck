@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ring-batch) begin
+(ring-batch) create "test.txt"
+(ring-batch) open "test.txt"
+(ring-batch) entered
+(ring-batch) tell
+(ring-batch) end
+ring-batch: exit(0)
+EOF
+pass;
@@ -0,0 +1,70 @@
+/* Writes sample.inc to a file with writev() in three pieces,
+   reads it back with pread() and readv(), and overwrites part
+   of it with pwrite(), checking that pread() and pwrite() leave
+   the file position alone. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char buf[sizeof sample];
+  struct iovec iov[3];
+  size_t size = sizeof sample - 1;
+  int handle, byte_cnt;
+
+  CHECK (create ("test.txt", size), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  iov[0].iov_base = (char *) sample;
+  iov[0].iov_len = 10;
+  iov[1].iov_base = (char *) sample + 10;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = (char *) sample + 10;
+  iov[2].iov_len = size - 10;
+  byte_cnt = writev (handle, iov, 3);
+  if (byte_cnt != (int) size)
+    fail ("writev() returned %d instead of %zu", byte_cnt, size);
+  if (tell (handle) != size)
+    fail ("position %u after writev() instead of %zu", tell (handle), size);
+
+  msg ("pread");
+  memset (buf, 0, sizeof buf);
+  byte_cnt = pread (handle, buf, size - 5, 5);
+  if (byte_cnt != (int) size - 5)
+    fail ("pread() returned %d instead of %zu", byte_cnt, size - 5);
+  if (memcmp (buf, sample + 5, size - 5))
+    fail ("pread() read wrong data");
+  if (tell (handle) != size)
+    fail ("pread() moved the position to %u", tell (handle));
+
+  msg ("readv");
+  seek (handle, 0);
+  memset (buf, 0, sizeof buf);
+  iov[0].iov_base = buf + 20;
+  iov[0].iov_len = size - 20;
+  iov[1].iov_base = buf;
+  iov[1].iov_len = 20;
+  byte_cnt = readv (handle, iov, 2);
+  if (byte_cnt != (int) size)
+    fail ("readv() returned %d instead of %zu", byte_cnt, size);
+  if (memcmp (buf + 20, sample, size - 20)
+      || memcmp (buf, sample + size - 20, 20))
+    fail ("readv() read wrong data");
+
+  msg ("pwrite");
+  seek (handle, 3);
+  byte_cnt = pwrite (handle, "XYZ", 3, 7);
+  if (byte_cnt != 3)
+    fail ("pwrite() returned %d instead of 3", byte_cnt);
+  if (tell (handle) != 3)
+    fail ("pwrite() moved the position to %u", tell (handle));
+  CHECK (pread (handle, buf, 5, 6) == 5, "pread after pwrite");
+  if (memcmp (buf, sample + 6, 1) || memcmp (buf + 1, "XYZ", 3)
+      || memcmp (buf + 4, sample + 10, 1))
+    fail ("pwrite() wrote wrong data");
+}
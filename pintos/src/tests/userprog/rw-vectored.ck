@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rw-vectored) begin
+(rw-vectored) create "test.txt"
+(rw-vectored) open "test.txt"
+(rw-vectored) pread
+(rw-vectored) readv
+(rw-vectored) pwrite
+(rw-vectored) pread after pwrite
+(rw-vectored) end
+rw-vectored: exit(0)
+EOF
+pass;
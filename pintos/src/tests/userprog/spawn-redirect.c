@@ -0,0 +1,42 @@
+/* Spawns a child with an argument that contains a space and with
+   a file opened as file descriptor 10, and checks what the child
+   wrote there and its exit status.  Then spawns a nonexistent
+   program, whose failure to load wait() must report as -1, and
+   a child whose arguments are too long, which spawn() must
+   refuse without killing us. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char long_arg[5000];
+
+void
+test_main (void)
+{
+  const char *child[] = {"child-spawn", "hello, world", NULL};
+  const char *missing[] = {"no-such-file", NULL};
+  const char *too_long[] = {"child-spawn", long_arg, NULL};
+  struct spawn_action action;
+  char buf[32];
+  int fd;
+
+  CHECK (create ("spawn.out", 0), "create \"spawn.out\"");
+  CHECK ((fd = open ("spawn.out")) > 1, "open \"spawn.out\"");
+
+  action.parent_fd = fd;
+  action.child_fd = 10;
+  msg ("wait(spawn()) = %d", wait (spawn (child, &action, 1)));
+
+  CHECK (read (fd, buf, sizeof buf) == (int) strlen (child[1]),
+         "read \"spawn.out\"");
+  if (memcmp (buf, child[1], strlen (child[1])))
+    fail ("child wrote wrong data");
+
+  msg ("wait(spawn(\"no-such-file\")) = %d",
+       wait (spawn (missing, NULL, 0)));
+
+  memset (long_arg, 'x', sizeof long_arg - 1);
+  msg ("spawn() with too-long arguments = %d", spawn (too_long, NULL, 0));
+}
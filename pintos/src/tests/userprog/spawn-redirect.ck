@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(spawn-redirect) begin
+(spawn-redirect) create "spawn.out"
+(spawn-redirect) open "spawn.out"
+child-spawn: exit(2)
+(spawn-redirect) wait(spawn()) = 2
+(spawn-redirect) read "spawn.out"
+load: no-such-file: open failed
+no-such-file: exit(-1)
+(spawn-redirect) wait(spawn("no-such-file")) = -1
+(spawn-redirect) spawn() with too-long arguments = -1
+(spawn-redirect) end
+spawn-redirect: exit(0)
+EOF
+pass;
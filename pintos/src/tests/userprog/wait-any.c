@@ -0,0 +1,43 @@
+/* Spawns several children and reaps them all with wait_any(),
+   which must return each child's pid exactly once, with its exit
+   status, and then -1 once there are no children left. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 3
+
+void
+test_main (void)
+{
+  const char *child[] = {"child-spawn", "x", NULL};
+  struct spawn_action action;
+  pid_t pids[CHILD_CNT];
+  int fd, i, j, status;
+
+  CHECK (create ("wait-any.out", 0), "create \"wait-any.out\"");
+  CHECK ((fd = open ("wait-any.out")) > 1, "open \"wait-any.out\"");
+
+  action.parent_fd = fd;
+  action.child_fd = 10;
+  for (i = 0; i < CHILD_CNT; i++)
+    if ((pids[i] = spawn (child, &action, 1)) == PID_ERROR)
+      fail ("spawn() returned %d", pids[i]);
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pid_t pid = wait_any (&status);
+
+      for (j = 0; j < CHILD_CNT; j++)
+        if (pids[j] == pid)
+          break;
+      if (j == CHILD_CNT)
+        fail ("wait_any() returned unexpected pid %d", pid);
+      if (status != 2)
+        fail ("wait_any() gave status %d for pid %d", status, pid);
+      pids[j] = PID_ERROR;
+    }
+  msg ("wait_any() reaped %d children", CHILD_CNT);
+  msg ("wait_any() = %d", wait_any (&status));
+}
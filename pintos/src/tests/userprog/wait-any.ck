@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(wait-any) begin
+(wait-any) create "wait-any.out"
+(wait-any) open "wait-any.out"
+child-spawn: exit(2)
+child-spawn: exit(2)
+child-spawn: exit(2)
+(wait-any) wait_any() reaped 3 children
+(wait-any) wait_any() = -1
+(wait-any) end
+wait-any: exit(0)
+EOF
+pass;
@@ -0,0 +1,40 @@
+/* Writes lines to the console a piece at a time, with write()
+   and writev(), and exits in the middle of a line, which must
+   still come out, ahead of the exit message. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static void
+write_str (const char *s)
+{
+  if (write (STDOUT_FILENO, s, strlen (s)) != (int) strlen (s))
+    fail ("write() returned wrong count");
+}
+
+void
+test_main (void)
+{
+  struct iovec iov[3];
+
+  write_str ("(write-lines) one");
+  write_str (", two");
+  write_str (", three\n(write-lines) four\n(write-lines) fi");
+  write_str ("ve\n");
+
+  iov[0].iov_base = "(write-lines) si";
+  iov[0].iov_len = strlen (iov[0].iov_base);
+  iov[1].iov_base = "x\n(write-lines) se";
+  iov[1].iov_len = strlen (iov[1].iov_base);
+  iov[2].iov_base = "ven\n";
+  iov[2].iov_len = strlen (iov[2].iov_base);
+  if (writev (STDOUT_FILENO, iov, 3)
+      != (int) (iov[0].iov_len + iov[1].iov_len + iov[2].iov_len))
+    fail ("writev() returned wrong count");
+
+  write_str ("(write-lines) eight");
+  exit (0);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(write-lines) begin
+(write-lines) one, two, three
+(write-lines) four
+(write-lines) five
+(write-lines) six
+(write-lines) seven
+(write-lines) eightwrite-lines: exit(0)
+EOF
+pass;
@@ -0,0 +1,42 @@
+#ifndef THREADS_ATOMIC_H
+#define THREADS_ATOMIC_H
+
+#include <stdint.h>
+
+/* Atomic operations on aligned 32-bit words.
+
+   Pintos runs on a single CPU, so these only need to be atomic
+   with respect to interrupts: each is a single instruction that
+   an interrupt cannot split.  The "lock" prefixes are kept so
+   that the code stays correct if that ever changes. */
+
+/* If *P equals OLD, stores NEW into *P.  Returns the value *P
+   had before, so the store happened iff the result is OLD. */
+static inline uint32_t
+atomic_cmpxchg (volatile uint32_t *p, uint32_t old, uint32_t new)
+{
+  uint32_t prev;
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "=a" (prev), "+m" (*p)
+                : "r" (new), "0" (old)
+                : "memory");
+  return prev;
+}
+
+/* Stores V into *P and returns the previous value. */
+static inline uint32_t
+atomic_xchg (volatile uint32_t *p, uint32_t v)
+{
+  asm volatile ("xchgl %0, %1" : "+r" (v), "+m" (*p) : : "memory");
+  return v;
+}
+
+/* Adds V to *P and returns the previous value. */
+static inline uint32_t
+atomic_fetch_add (volatile uint32_t *p, uint32_t v)
+{
+  asm volatile ("lock xaddl %0, %1" : "+r" (v), "+m" (*p) : : "memory");
+  return v;
+}
+
+#endif /* threads/atomic.h */
@@ -38,6 +38,11 @@
 #include "filesys/fsutil.h"
 #include "filesys/buffer-cache.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -87,7 +92,7 @@ main (void)
   argv = parse_options (argv);
 
   /* Initialize ourselves as a thread so we can use locks,
-     then enable console locking. */
+     then set up the console output buffer. */
   thread_init ();
   console_init ();
 
@@ -119,6 +124,7 @@ main (void)
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
   serial_init_queue ();
+  console_start ();
   timer_calibrate ();
 
 #ifdef FILESYS
@@ -127,6 +133,11 @@ main (void)
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
+#ifdef VM
+  page_init ();
+  frame_init ();
+  swap_init ();
+#endif
 
   printf ("Boot complete.\n");
 
@@ -260,9 +271,15 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-sched-trace"))
+        sched_trace_enabled = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-sl"))
+        stack_page_limit = atoi (value);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -383,8 +400,12 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -sched-trace       Trace scheduling, dump it on power off.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -sl=COUNT          Limit user stacks to COUNT pages.\n"
 #endif
           );
   shutdown_power_off ();
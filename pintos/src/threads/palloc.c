@@ -1,14 +1,14 @@
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,14 +23,59 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a binary buddy allocator.  Its free pages are
+   grouped into blocks of 2**ORDER pages, each aligned, relative
+   to the pool's base, on a multiple of its size, and kept on a
+   free list per order.  A request for N pages takes a block of
+   the smallest order that holds N pages, splitting a larger
+   block in halves if need be, and gives back the pages past the
+   first N.  A freed block merges with its "buddy", the other
+   half of the block of the next order up, whenever the buddy is
+   free too, so free memory gathers back into large blocks.
+   Allocating and freeing thus take time proportional to the
+   number of orders, rather than to the size of the pool.
+
+   Free pages hold their own free list links.  A byte per page,
+   kept at the start of the pool, tells whether the page starts a
+   free block and, if so, the block's order.  The free lists are
+   changed with interrupts off, not under a lock, because a dying
+   thread's page is freed from the scheduler.
+
+   Each pool also keeps a supply of up to ZEROED_MAX pages that
+   are already filled with zeros, which the idle thread tops up
+   by calling palloc_prezero().  A request for a single page with
+   PAL_ZERO takes one of these, if there is one, instead of
+   zeroing a page while the caller waits.  The supply is given
+   back to the free lists whenever a request cannot otherwise be
+   met. */
+
+/* Number of block orders.  Blocks are at most 2**(ORDER_CNT - 1)
+   pages, which is 1 GB. */
+#define ORDER_CNT 19
+
+/* Value of a page's byte in `orders' if it does not start a free
+   block; otherwise the byte is the block's order. */
+#define NOT_FREE 0xff
+
+/* Maximum number of zeroed pages kept ready in each pool. */
+#define ZEROED_MAX 32
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages. */
+    size_t free_cnt;                    /* Number of free pages. */
+    uint8_t *orders;                    /* Order of free block at each page. */
+    struct list free[ORDER_CNT];        /* Free blocks, by order. */
+
+    /* Pages zeroed in advance. */
+    struct list zeroed;                 /* Zeroed pages. */
+    size_t zeroed_cnt;                  /* Zeroed pages, or being zeroed. */
+    long long zeroed_hits;              /* PAL_ZERO pages from `zeroed'. */
+    long long zeroed_misses;            /* PAL_ZERO pages zeroed on demand. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -39,6 +84,12 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static void *take_block (struct pool *, size_t order);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void *take_zeroed (struct pool *);
+static bool drain_zeroed (struct pool *);
+static void prezero_pool (struct pool *);
+static void print_pool_stats (struct pool *, const char *name);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -61,6 +112,18 @@ palloc_init (size_t user_page_limit)
              user_pages, "user pool");
 }
 
+/* Returns the smallest order of a block of at least PAGE_CNT
+   pages. */
+static size_t
+order_for (size_t page_cnt)
+{
+  size_t order = 0;
+
+  while (((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
+}
+
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
    If PAL_USER is set, the pages are obtained from the user pool,
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
@@ -71,24 +134,46 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-  void *pages;
-  size_t page_idx;
+  void *pages = NULL;
+  bool zeroed = false;
+  size_t order;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
-
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
+  order = order_for (page_cnt);
+  if (order < ORDER_CNT)
+    {
+      enum intr_level old_level = intr_disable ();
+      if (page_cnt == 1 && (flags & PAL_ZERO))
+        {
+          pages = take_zeroed (pool);
+          zeroed = pages != NULL;
+          if (zeroed)
+            pool->zeroed_hits++;
+          else
+            pool->zeroed_misses++;
+        }
+      if (pages == NULL)
+        {
+          pages = take_block (pool, order);
+          if (pages == NULL && drain_zeroed (pool))
+            pages = take_block (pool, order);
+        }
+      if (pages != NULL && !zeroed)
+        {
+          /* Give back the pages past the first PAGE_CNT. */
+          size_t page_idx = pg_no (pages) - pg_no (pool->base);
+          size_t excess = ((size_t) 1 << order) - page_cnt;
+          pool->free_cnt += excess;
+          free_range (pool, page_idx + page_cnt, excess);
+        }
+      intr_set_level (old_level);
+    }
 
   if (pages != NULL)
     {
-      if (flags & PAL_ZERO)
+      if ((flags & PAL_ZERO) && !zeroed)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else
@@ -119,6 +204,7 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 {
   struct pool *pool;
   size_t page_idx;
+  enum intr_level old_level;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
@@ -132,13 +218,17 @@ palloc_free_multiple (void *pages, size_t page_cnt)
     NOT_REACHED ();
 
   page_idx = pg_no (pages) - pg_no (pool->base);
+  ASSERT (page_idx + page_cnt <= pool->page_cnt);
 
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  old_level = intr_disable ();
+  ASSERT (pool->orders[page_idx] == NOT_FREE);
+  pool->free_cnt += page_cnt;
+  free_range (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +238,218 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Returns the number of free pages in the user pool. */
+size_t
+palloc_user_free_cnt (void)
+{
+  return user_pool.free_cnt + user_pool.zeroed_cnt;
+}
+
+/* Zeroes free pages into the supply of zeroed pages of each
+   pool until the supplies are full or there are no free pages
+   left.  Called by the idle thread, which is preempted as soon
+   as another thread is ready to run. */
+void
+palloc_prezero (void)
+{
+  prezero_pool (&kernel_pool);
+  prezero_pool (&user_pool);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void)
+{
+  print_pool_stats (&kernel_pool, "Kernel pool");
+  print_pool_stats (&user_pool, "User pool");
+}
+
+/* Returns the page with index PAGE_IDX in POOL. */
+static inline struct list_elem *
+pool_page (const struct pool *pool, size_t page_idx)
+{
+  return (struct list_elem *) (pool->base + page_idx * PGSIZE);
+}
+
+/* Removes a free block of 2**ORDER pages from POOL, splitting a
+   larger block if there is none of that order, and returns it.
+   Returns a null pointer if there is no block large enough.
+   Does not count the pages as allocated.  Interrupts must be
+   off. */
+static void *
+take_block (struct pool *pool, size_t order)
+{
+  size_t o, page_idx;
+  void *block;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (o = order; o < ORDER_CNT; o++)
+    if (!list_empty (&pool->free[o]))
+      break;
+  if (o == ORDER_CNT)
+    return NULL;
+
+  block = list_pop_front (&pool->free[o]);
+  page_idx = pg_no (block) - pg_no (pool->base);
+  pool->orders[page_idx] = NOT_FREE;
+  pool->free_cnt -= (size_t) 1 << o;
+
+  /* Split, keeping the lower half each time and freeing the
+     upper. */
+  while (o > order)
+    {
+      size_t buddy_idx;
+
+      o--;
+      buddy_idx = page_idx + ((size_t) 1 << o);
+      pool->orders[buddy_idx] = o;
+      list_push_front (&pool->free[o], pool_page (pool, buddy_idx));
+      pool->free_cnt += (size_t) 1 << o;
+    }
+  return block;
+}
+
+/* Adds the free block of 2**ORDER pages starting at page PAGE_IDX
+   to POOL, first merging it with its buddy for as long as the
+   buddy is free.  Interrupts must be off. */
+static void
+free_block (struct pool *pool, size_t page_idx, size_t order)
+{
+  while (order + 1 < ORDER_CNT)
+    {
+      size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+
+      if (buddy_idx + ((size_t) 1 << order) > pool->page_cnt
+          || pool->orders[buddy_idx] != order)
+        break;
+      list_remove (pool_page (pool, buddy_idx));
+      pool->orders[buddy_idx] = NOT_FREE;
+      if (buddy_idx < page_idx)
+        page_idx = buddy_idx;
+      order++;
+    }
+  pool->orders[page_idx] = order;
+  list_push_front (&pool->free[order], pool_page (pool, page_idx));
+}
+
+/* Removes and returns a page from POOL's supply of zeroed pages,
+   or returns a null pointer if it is empty.  Interrupts must be
+   off. */
+static void *
+take_zeroed (struct pool *pool)
+{
+  struct list_elem *page;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (list_empty (&pool->zeroed))
+    return NULL;
+  page = list_pop_front (&pool->zeroed);
+  pool->zeroed_cnt--;
+  memset (page, 0, sizeof *page);
+  return page;
+}
+
+/* Gives all of POOL's zeroed pages back to its free lists.
+   Returns true if there were any.  Interrupts must be off. */
+static bool
+drain_zeroed (struct pool *pool)
+{
+  bool drained = false;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (!list_empty (&pool->zeroed))
+    {
+      struct list_elem *page = list_pop_front (&pool->zeroed);
+      pool->zeroed_cnt--;
+      pool->free_cnt++;
+      free_range (pool, pg_no (page) - pg_no (pool->base), 1);
+      drained = true;
+    }
+  return drained;
+}
+
+/* Zeroes free pages of POOL into its supply of zeroed pages
+   until the supply is full or no free page is left.  Each page
+   is zeroed with interrupts on.  While it is, it is counted in
+   `zeroed_cnt' but is not yet on the list. */
+static void
+prezero_pool (struct pool *pool)
+{
+  for (;;)
+    {
+      enum intr_level old_level = intr_disable ();
+      struct list_elem *page = NULL;
+
+      if (pool->zeroed_cnt < ZEROED_MAX)
+        page = take_block (pool, 0);
+      if (page != NULL)
+        pool->zeroed_cnt++;
+      intr_set_level (old_level);
+      if (page == NULL)
+        return;
+
+      memset (page, 0, PGSIZE);
+
+      old_level = intr_disable ();
+      list_push_front (&pool->zeroed, page);
+      intr_set_level (old_level);
+    }
+}
+
+/* Frees the PAGE_CNT pages of POOL starting at page PAGE_IDX, as
+   the largest aligned blocks that cover them.  Does not count
+   the pages as free.  Interrupts must be off. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  size_t end = page_idx + page_cnt;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (page_idx < end)
+    {
+      size_t order = 0;
+
+      while (order + 1 < ORDER_CNT
+             && page_idx % ((size_t) 1 << (order + 1)) == 0
+             && page_idx + ((size_t) 1 << (order + 1)) <= end)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+    }
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's order map at its base.
+     Calculate the space needed for the map
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
-  if (bm_pages > page_cnt)
-    PANIC ("Not enough memory in %s for bitmap.", name);
-  page_cnt -= bm_pages;
+  size_t map_pages = DIV_ROUND_UP (page_cnt, PGSIZE);
+  size_t order;
+  if (map_pages > page_cnt)
+    PANIC ("Not enough memory in %s for order map.", name);
+  page_cnt -= map_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
-  /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
-  p->base = base + bm_pages * PGSIZE;
+  /* Initialize the pool, with every page free. */
+  p->base = (uint8_t *) base + map_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  p->free_cnt = page_cnt;
+  p->orders = base;
+  memset (p->orders, NOT_FREE, page_cnt);
+  for (order = 0; order < ORDER_CNT; order++)
+    list_init (&p->free[order]);
+  free_range (p, 0, page_cnt);
+  list_init (&p->zeroed);
+  p->zeroed_cnt = 0;
+  p->zeroed_hits = p->zeroed_misses = 0;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -176,7 +459,47 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Prints statistics for POOL, named NAME: its free pages, its
+   free blocks by order, and how fragmented its free memory is,
+   that is, by what percentage its largest free block falls short
+   of the largest block that as many free pages could form. */
+static void
+print_pool_stats (struct pool *pool, const char *name)
+{
+  size_t block_cnt[ORDER_CNT];
+  size_t free_cnt, zeroed_cnt, largest = 0, ideal = 1;
+  long long zeroed_hits, zeroed_misses;
+  size_t order;
+  enum intr_level old_level;
+
+  /* Take a snapshot, then print it. */
+  old_level = intr_disable ();
+  free_cnt = pool->free_cnt;
+  zeroed_cnt = pool->zeroed_cnt;
+  zeroed_hits = pool->zeroed_hits;
+  zeroed_misses = pool->zeroed_misses;
+  for (order = 0; order < ORDER_CNT; order++)
+    block_cnt[order] = list_size (&pool->free[order]);
+  intr_set_level (old_level);
+
+  printf ("%s: %zu of %zu pages free, free blocks by order:",
+          name, free_cnt, pool->page_cnt);
+  for (order = 0; order < ORDER_CNT; order++)
+    if (block_cnt[order] > 0)
+      {
+        printf (" %zu:%zu", order, block_cnt[order]);
+        largest = (size_t) 1 << order;
+      }
+  while (ideal * 2 <= free_cnt && order_for (ideal * 2) < ORDER_CNT)
+    ideal *= 2;
+  printf ("\n%s: largest free block %zu pages, %zu%% fragmented\n",
+          name, largest, free_cnt > 0 ? 100 - largest * 100 / ideal : 0);
+  printf ("%s: %zu zeroed pages ready, %lld PAL_ZERO pages taken from them, "
+          "%lld zeroed on demand\n",
+          name, zeroed_cnt, zeroed_hits, zeroed_misses);
+}
@@ -0,0 +1,222 @@
+#include "threads/sched-trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* If true, scheduling events are recorded.
+   Controlled by kernel command-line option "-sched-trace". */
+bool sched_trace_enabled;
+
+/* The ring.  SCHED_HEAD counts every event ever recorded; the
+   slot for the next one is SCHED_HEAD % SCHED_TRACE_SIZE. */
+static struct sched_event sched_ring[SCHED_TRACE_SIZE];
+static uint32_t sched_head;
+
+/* Set while the ring is being printed, so that the events being
+   printed are not overwritten underneath us.  Also keeps a
+   second dump from starting meanwhile: it is skipped instead.
+   This works even in an interrupt handler or a kernel panic,
+   where a lock could not be waited for. */
+static bool sched_paused;
+
+/* Snapshot of the live threads' histograms, filled with
+   interrupts off and printed with interrupts on. */
+#define SNAPSHOT_MAX 64
+static struct
+  {
+    int tid;
+    char name[16];
+    struct sched_hist hist;
+  }
+snapshot[SNAPSHOT_MAX];
+static size_t snapshot_cnt;
+
+static const char *event_names[] =
+  {
+    [SCHED_EV_SWITCH] = "Run",
+    [SCHED_EV_WAKEUP] = "Wakeup of",
+    [SCHED_EV_LOCK_WAIT] = "Lock wait for",
+    [SCHED_EV_DONATE] = "Donation to",
+  };
+
+/* Reads the CPU's time stamp counter. */
+static inline uint64_t
+sched_clock (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Adds the delay since STAMP to histogram HIST. */
+static void
+hist_add (uint32_t hist[SCHED_HIST_BUCKETS], uint64_t stamp, uint64_t now)
+{
+  uint32_t kcycles;
+  int bucket = 0;
+
+  if (stamp == 0 || now < stamp)
+    return;
+  kcycles = (now - stamp) >> 10;
+  while (kcycles > 1 && bucket < SCHED_HIST_BUCKETS - 1)
+    {
+      kcycles >>= 1;
+      bucket++;
+    }
+  hist[bucket]++;
+}
+
+/* Appends an event of the given TYPE to the ring.
+   Must be called with interrupts off. */
+void
+sched_trace_record (enum sched_event_type type, int tid, int other,
+                    int priority)
+{
+  struct sched_event *ev;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!sched_trace_enabled || sched_paused)
+    return;
+
+  ev = &sched_ring[sched_head++ % SCHED_TRACE_SIZE];
+  ev->time = sched_clock ();
+  ev->tid = tid;
+  ev->other = other;
+  ev->type = type;
+  ev->priority = priority;
+}
+
+/* Marks the owner of HIST as having entered the ready queue
+   without blocking (a yield or a preemption). */
+void
+sched_hist_ready (struct sched_hist *hist)
+{
+  if (sched_trace_enabled)
+    hist->stamp = sched_clock ();
+}
+
+/* Marks the owner of HIST as blocked. */
+void
+sched_hist_block (struct sched_hist *hist)
+{
+  if (sched_trace_enabled)
+    hist->stamp = sched_clock ();
+}
+
+/* Accounts the wait of a blocked thread that has just been made
+   ready. */
+void
+sched_hist_wakeup (struct sched_hist *hist)
+{
+  uint64_t now;
+
+  if (!sched_trace_enabled)
+    return;
+  now = sched_clock ();
+  hist_add (hist->wait, hist->stamp, now);
+  hist->stamp = now;
+}
+
+/* Accounts the run-queue latency of a thread that has just been
+   picked to run. */
+void
+sched_hist_run (struct sched_hist *hist)
+{
+  if (!sched_trace_enabled)
+    return;
+  hist_add (hist->runq, hist->stamp, sched_clock ());
+  hist->stamp = 0;
+}
+
+/* Prints HIST, which belongs to thread TID named NAME. */
+static void
+sched_hist_print (int tid, const char *name, const struct sched_hist *hist)
+{
+  int i;
+
+  printf ("Histogram of Task %d (%s) runq:", tid, name);
+  for (i = 0; i < SCHED_HIST_BUCKETS; i++)
+    printf (" %"PRIu32, hist->runq[i]);
+  printf (" wait:");
+  for (i = 0; i < SCHED_HIST_BUCKETS; i++)
+    printf (" %"PRIu32, hist->wait[i]);
+  printf ("\n");
+}
+
+/* thread_foreach() helper that copies T's histograms into the
+   snapshot. */
+static void
+snapshot_thread (struct thread *t, void *aux UNUSED)
+{
+  if (snapshot_cnt < SNAPSHOT_MAX)
+    {
+      snapshot[snapshot_cnt].tid = t->tid;
+      strlcpy (snapshot[snapshot_cnt].name, t->name,
+               sizeof snapshot[snapshot_cnt].name);
+      snapshot[snapshot_cnt].hist = t->sched_hist;
+      snapshot_cnt++;
+    }
+}
+
+/* Prints the recorded events, oldest first, one per line, in
+   the "TIME: EVENT Task TID" form used by the schedlab
+   notebook, followed by the histograms of every live thread.
+   Does nothing if another dump is in progress. */
+void
+sched_trace_dump (void)
+{
+  enum intr_level old_level;
+  uint32_t head, first, i;
+  size_t j;
+
+  if (!sched_trace_enabled)
+    return;
+
+  old_level = intr_disable ();
+  if (sched_paused)
+    {
+      intr_set_level (old_level);
+      return;
+    }
+  sched_paused = true;
+  head = sched_head;
+  snapshot_cnt = 0;
+  thread_foreach (snapshot_thread, NULL);
+  intr_set_level (old_level);
+
+  first = head > SCHED_TRACE_SIZE ? head - SCHED_TRACE_SIZE : 0;
+  printf ("Scheduler trace: %"PRIu32" events, %"PRIu32" shown, "
+          "time in cycles\n", head, head - first);
+  for (i = first; i != head; i++)
+    {
+      const struct sched_event *ev = &sched_ring[i % SCHED_TRACE_SIZE];
+      printf ("%"PRIu64": %s Task %d", ev->time, event_names[ev->type],
+              ev->tid);
+      switch (ev->type)
+        {
+        case SCHED_EV_SWITCH:
+          printf (" (from Task %d, priority %d)\n", ev->other, ev->priority);
+          break;
+        case SCHED_EV_LOCK_WAIT:
+          printf (" (holder Task %d)\n", ev->other);
+          break;
+        case SCHED_EV_DONATE:
+          printf (" (from Task %d, priority %d)\n", ev->other, ev->priority);
+          break;
+        default:
+          printf (" (priority %d)\n", ev->priority);
+          break;
+        }
+    }
+
+  for (j = 0; j < snapshot_cnt; j++)
+    sched_hist_print (snapshot[j].tid, snapshot[j].name, &snapshot[j].hist);
+
+  old_level = intr_disable ();
+  sched_paused = false;
+  intr_set_level (old_level);
+}
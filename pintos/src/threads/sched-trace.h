@@ -0,0 +1,68 @@
+#ifndef THREADS_SCHED_TRACE_H
+#define THREADS_SCHED_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Scheduler tracing.
+
+   Scheduling events are appended to a fixed-size ring buffer
+   that silently overwrites its oldest entries.  Every caller
+   already runs with interrupts off (the scheduler, the wakeup
+   path and the donation walk all do), so recording an event is
+   a plain store and an index increment: no lock is taken and
+   nothing can sleep.
+
+   Tracing is off unless the kernel is started with the
+   "-sched-trace" option.  The ring and the per-thread latency
+   histograms are then printed by thread_print_stats() at
+   shutdown, or on demand through the sched_dump() system
+   call. */
+
+/* Number of events kept in the ring.  Must be a power of 2. */
+#define SCHED_TRACE_SIZE 1024
+
+/* Number of buckets in a latency histogram.  Bucket I counts
+   delays of [2**I, 2**(I+1)) kilocycles; bucket 0 also counts
+   anything shorter, the last bucket anything longer. */
+#define SCHED_HIST_BUCKETS 16
+
+/* Kinds of traced events. */
+enum sched_event_type
+  {
+    SCHED_EV_SWITCH,            /* TID got the CPU from OTHER. */
+    SCHED_EV_WAKEUP,            /* TID was unblocked. */
+    SCHED_EV_LOCK_WAIT,         /* TID blocked on a lock held by OTHER. */
+    SCHED_EV_DONATE             /* OTHER donated PRIORITY to TID. */
+  };
+
+/* One traced event. */
+struct sched_event
+  {
+    uint64_t time;              /* Time stamp counter at the event. */
+    int tid;                    /* Thread the event is about. */
+    int other;                  /* Second thread involved, or 0. */
+    uint8_t type;               /* One of enum sched_event_type. */
+    uint8_t priority;           /* Effective priority after the event. */
+  };
+
+/* Per-thread latency histograms, embedded in struct thread. */
+struct sched_hist
+  {
+    uint64_t stamp;             /* When the thread last became ready
+                                   or blocked. */
+    uint32_t runq[SCHED_HIST_BUCKETS];  /* Ready -> running delays. */
+    uint32_t wait[SCHED_HIST_BUCKETS];  /* Blocked -> ready delays. */
+  };
+
+extern bool sched_trace_enabled;
+
+void sched_trace_record (enum sched_event_type, int tid, int other,
+                         int priority);
+void sched_hist_ready (struct sched_hist *);
+void sched_hist_block (struct sched_hist *);
+void sched_hist_run (struct sched_hist *);
+void sched_hist_wakeup (struct sched_hist *);
+void sched_trace_dump (void);
+
+#endif /* threads/sched-trace.h */
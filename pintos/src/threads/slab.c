@@ -0,0 +1,240 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Object caches.
+
+   malloc() rounds every request up to a power of 2, which wastes
+   up to half of each block on objects whose size is just past
+   one.  An object cache instead hands out objects of a single,
+   exact size.  Each of its "slabs" is a page holding a header,
+   an array of indexes of the slab's free objects, and as many
+   objects as fit after that.
+
+   A cache may have a constructor, which is run on each object
+   once, when its slab is created, rather than on each
+   allocation.  Objects must therefore be returned to the cache
+   in their constructed state, for example with any locks they
+   contain released.
+
+   Slabs are kept on three lists, by how many of their objects
+   are in use.  Objects are allocated from partly used slabs
+   before empty ones, so that slabs fill up and others can empty
+   out.  A cache keeps one empty slab back rather than returning
+   it to the page allocator at once. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* A cache. */
+struct kmem_cache
+  {
+    struct list_elem elem;      /* Element in `caches'. */
+    const char *name;           /* Name, for statistics. */
+    size_t size;                /* Object size in bytes. */
+    size_t stride;              /* Object size rounded up to alignment. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    size_t obj_ofs;             /* Offset of first object in slab. */
+    void (*ctor) (void *);      /* Constructor, or null. */
+
+    struct lock lock;           /* Guards the members below. */
+    struct list partial;        /* Slabs with some objects in use. */
+    struct list full;           /* Slabs with all objects in use. */
+    struct list empty;          /* Slabs with no objects in use. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Slabs in the cache. */
+    size_t in_use;              /* Objects in use. */
+    long long alloc_cnt;        /* Number of allocations. */
+    long long free_cnt;         /* Number of frees. */
+  };
+
+/* A slab: the header at the start of its page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct list_elem elem;      /* Element in one of cache's lists. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    size_t free_cnt;            /* Number of free objects. */
+    uint16_t free[];            /* Indexes of free objects. */
+  };
+
+/* All caches, for statistics. */
+static struct list caches = LIST_INITIALIZER (caches);
+
+/* Creates and returns a cache of objects of SIZE bytes each,
+   aligned on ALIGN bytes, a power of 2, or on a pointer's size if
+   ALIGN is 0.  NAME is used in statistics and must stay valid.
+   If CTOR is nonnull, it is called on each object when the
+   object's slab is created.  Panics if memory is not available,
+   since caches are created during initialization. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, size_t align,
+                   void (*ctor) (void *))
+{
+  struct kmem_cache *c;
+  size_t n;
+
+  if (align == 0)
+    align = sizeof (void *);
+  ASSERT (size > 0);
+  ASSERT ((align & (align - 1)) == 0);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    PANIC ("kmem_cache_create: out of memory creating %s", name);
+  c->name = name;
+  c->size = size;
+  c->stride = ROUND_UP (size, align);
+  c->ctor = ctor;
+
+  /* Fit as many objects as possible, along with their indexes,
+     after the header. */
+  for (n = (PGSIZE - sizeof (struct slab)) / c->stride; n > 0; n--)
+    {
+      size_t ofs = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                             align);
+      if (ofs + n * c->stride <= PGSIZE)
+        {
+          c->obj_ofs = ofs;
+          break;
+        }
+    }
+  ASSERT (n > 0);
+  c->objs_per_slab = n;
+
+  lock_init (&c->lock);
+  list_init (&c->partial);
+  list_init (&c->full);
+  list_init (&c->empty);
+  c->slab_cnt = c->in_use = 0;
+  c->alloc_cnt = c->free_cnt = 0;
+
+  list_push_back (&caches, &c->elem);
+  return c;
+}
+
+/* Returns the object with index IDX in slab S. */
+static void *
+slab_obj (struct slab *s, size_t idx)
+{
+  return (uint8_t *) s + s->cache->obj_ofs + idx * s->cache->stride;
+}
+
+/* Creates a new slab for cache C, constructing its objects, and
+   adds it to C's empty list.  Returns the slab, or a null
+   pointer if memory is not available.  C's lock must be held. */
+static struct slab *
+slab_create (struct kmem_cache *c)
+{
+  struct slab *s = palloc_get_page (0);
+  size_t i;
+
+  if (s == NULL)
+    return NULL;
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->free_cnt = c->objs_per_slab;
+  for (i = 0; i < c->objs_per_slab; i++)
+    {
+      s->free[i] = i;
+      if (c->ctor != NULL)
+        c->ctor (slab_obj (s, i));
+    }
+  list_push_back (&c->empty, &s->elem);
+  c->slab_cnt++;
+  return s;
+}
+
+/* Allocates and returns an object from cache C.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else if (!list_empty (&c->empty))
+    s = list_entry (list_front (&c->empty), struct slab, elem);
+  else
+    {
+      s = slab_create (c);
+      if (s == NULL)
+        {
+          lock_release (&c->lock);
+          return NULL;
+        }
+    }
+
+  obj = slab_obj (s, s->free[--s->free_cnt]);
+  list_remove (&s->elem);
+  list_push_front (s->free_cnt == 0 ? &c->full : &c->partial, &s->elem);
+  c->in_use++;
+  c->alloc_cnt++;
+  lock_release (&c->lock);
+  return obj;
+}
+
+/* Returns OBJ, which must have been allocated from cache C and
+   must be in its constructed state, to C. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+  size_t ofs;
+
+  if (obj == NULL)
+    return;
+
+  s = pg_round_down (obj);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  ofs = pg_ofs (obj) - c->obj_ofs;
+  ASSERT (ofs % c->stride == 0);
+
+  lock_acquire (&c->lock);
+  ASSERT (s->free_cnt < c->objs_per_slab);
+  s->free[s->free_cnt++] = ofs / c->stride;
+  c->in_use--;
+  c->free_cnt++;
+
+  list_remove (&s->elem);
+  if (s->free_cnt < c->objs_per_slab)
+    list_push_front (&c->partial, &s->elem);
+  else if (list_empty (&c->empty))
+    list_push_front (&c->empty, &s->elem);
+  else
+    {
+      /* Keep only one empty slab. */
+      s->magic = 0;
+      palloc_free_page (s);
+      c->slab_cnt--;
+    }
+  lock_release (&c->lock);
+}
+
+/* Prints object cache statistics. */
+void
+kmem_cache_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&caches); e != list_end (&caches); e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      printf ("Slab %s: %zu-byte objects, %zu per slab, %zu in use, "
+              "%zu slabs, %lld allocs, %lld frees\n",
+              c->name, c->size, c->objs_per_slab, c->in_use, c->slab_cnt,
+              c->alloc_cnt, c->free_cnt);
+    }
+}
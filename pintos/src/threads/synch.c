@@ -29,11 +29,17 @@
 #include "threads/synch.h"
 #include <stdio.h>
 #include <string.h>
+#include "threads/atomic.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
 extern struct list ready_list;
 
+static bool waiter_less (const struct heap_elem *, const struct heap_elem *,
+                         void *aux);
+static void sema_enqueue (struct semaphore *);
+static struct thread *sema_dequeue (struct semaphore *);
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -49,7 +55,7 @@ sema_init (struct semaphore *sema, unsigned value)
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  heap_init (&sema->waiters, waiter_less, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -70,7 +76,7 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0)
     {
-      list_insert_ordered (&sema->waiters, &thread_current ()->elem, waiters_max_priority, NULL);
+      sema_enqueue (sema);
       thread_block ();
     }
   sema->value--;
@@ -111,16 +117,13 @@ void
 sema_up (struct semaphore *sema)
 {
   enum intr_level old_level;
-  struct list_elem *e = NULL;
   struct thread *t = NULL;
 
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters)) {
-    e = list_max (&sema->waiters, waiters_max_priority, NULL);
-    list_remove (e);
-    t = list_entry (e, struct thread, elem);
+  if (!heap_empty (&sema->waiters)) {
+    t = sema_dequeue (sema);
     thread_unblock (t);
   }
   sema->value++;
@@ -134,14 +137,66 @@ sema_up (struct semaphore *sema)
   intr_set_level (old_level);
 }
 
-bool
-waiters_max_priority (const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+/* Semaphore waiters are kept in a pairing heap ordered by
+   effective priority, so that sema_up() finds the thread to wake
+   in O(log n) time.  A blocked thread whose priority is raised
+   by donation is moved up in the heap it waits in, so the order
+   never goes stale. */
+
+/* Compares the effective priorities of the threads that own
+   semaphore waiters elements A and B. */
+static bool
+waiter_less (const struct heap_elem *a, const struct heap_elem *b,
+             void *aux UNUSED)
 {
-  struct thread *ta = list_entry (a, struct thread, elem);
-  struct thread *tb = list_entry (b, struct thread, elem);
+  struct thread *ta = heap_entry (a, struct thread, wait_elem);
+  struct thread *tb = heap_entry (b, struct thread, wait_elem);
   return ta->effective_priority < tb->effective_priority;
 }
 
+/* Adds the current thread to SEMA's waiters.
+   Interrupts must be off. */
+static void
+sema_enqueue (struct semaphore *sema)
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  heap_push (&sema->waiters, &cur->wait_elem);
+  if (cur->wait_queue == NULL)
+    {
+      cur->wait_queue = &sema->waiters;
+      cur->wait_node = &cur->wait_elem;
+    }
+}
+
+/* Removes the highest-priority thread from SEMA's waiters and
+   returns it.  Interrupts must be off. */
+static struct thread *
+sema_dequeue (struct semaphore *sema)
+{
+  struct thread *t;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  t = heap_entry (heap_pop (&sema->waiters), struct thread, wait_elem);
+  if (t->wait_queue == &sema->waiters)
+    t->wait_queue = NULL;
+  return t;
+}
+
+/* Returns the highest effective priority among the threads
+   waiting for SEMA, or PRI_MIN if there are none. */
+int
+sema_waiters_priority (const struct semaphore *sema)
+{
+  if (heap_empty (&sema->waiters))
+    return PRI_MIN;
+  return heap_entry (heap_top (&sema->waiters), struct thread,
+                     wait_elem)->effective_priority;
+}
+
 static void sema_test_helper (void *sema_);
 
 /* Self-test for semaphores that makes control "ping-pong"
@@ -204,6 +259,7 @@ lock_init (struct lock *lock)
 }
 
 static void thread_recursive_donate (struct thread *t, int donate_priority);
+static void donate_readers (struct rwlock *rw, int donate_priority);
 
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
@@ -227,6 +283,8 @@ lock_acquire (struct lock *lock)
 
   if (owner != NULL) {
     cur->wait_lock = lock;
+    sched_trace_record (SCHED_EV_LOCK_WAIT, cur->tid, owner->tid,
+                        cur->effective_priority);
     if (owner->effective_priority < thread_get_priority ()) {
       thread_recursive_donate (owner, thread_get_priority ());
     }
@@ -245,10 +303,20 @@ thread_recursive_donate (struct thread *t, int donate_priority)
   while (t != NULL) {
     if (t->effective_priority < donate_priority) {
       t->effective_priority = donate_priority;
+      sched_trace_record (SCHED_EV_DONATE, t->tid, thread_tid (),
+                          donate_priority);
+      if (t->wait_queue != NULL)
+        heap_increase (t->wait_queue, t->wait_node);
     } else {
       break;
     }
-    if (t->wait_lock != NULL) {
+    if (t->wait_lock != NULL && t->wait_lock->holder == NULL
+        && t->wait_rwlock != NULL) {
+      /* Blocked on an rwlock held for reading: every reader
+        stands in the way. */
+      donate_readers (t->wait_rwlock, donate_priority);
+      break;
+    } else if (t->wait_lock != NULL) {
       t = t->wait_lock->holder;
     } else if (t->status == THREAD_READY) {
       /* Set effective priority of ready thread. Need to
@@ -321,14 +389,516 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
+/* Adaptive locks and readers-writer locks.
+
+   Both keep their state in one word that the uncontended paths
+   update with a single atomic instruction.  A thread that finds
+   the word taken yields up to SPIN_CNT times if the holder is
+   merely waiting for the CPU at our priority or better (on a
+   single CPU that is the only way "spinning" can make
+   progress), and otherwise blocks on the waiters list of the
+   embedded struct lock.  Blocking threads link that lock into
+   the holder's owned_locks and set their wait_lock to it, so
+   thread_recursive_donate() and set_effective_priority() handle
+   it like any other lock. */
+
+/* Yields allowed to a contended acquire before it blocks. */
+#define SPIN_CNT 4
+
+/* Mutex owner flag: threads are blocked in the embedded lock. */
+#define MUTEX_CONTENDED 0x1u
+
+/* Readers-writer lock state: threads are blocked in the embedded
+   lock; the other bits are a writer; one reader. */
+#define RW_WAITERS 0x1u
+#define RW_WRITER 0x2u
+#define RW_READER 0x4u
+
+/* Bits of a state word that may hold flags rather than a thread.
+   Threads are page-aligned, so these are always free. */
+#define STATE_FLAGS 0xfffu
+
+/* Returns the thread encoded in state word STATE. */
+static inline struct thread *
+state_thread (uint32_t state)
+{
+  return (struct thread *) (state & ~STATE_FLAGS);
+}
+
+/* Returns true if a contended acquire should yield to OWNER
+   rather than block: OWNER is ready to run, and will be run
+   before us if we yield. */
+static bool
+should_spin (struct thread *owner)
+{
+  return (owner != NULL && owner->status == THREAD_READY
+          && owner->effective_priority >= thread_get_priority ());
+}
+
+/* Makes OWNER the holder of LOCK for donation purposes.
+   Interrupts must be off. */
+static void
+contended_register (struct lock *lock, struct thread *owner)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (lock->holder == owner)
+    return;
+  if (lock->holder != NULL)
+    list_remove (&lock->elem);
+  lock->holder = owner;
+  list_push_back (&owner->owned_locks, &lock->elem);
+}
+
+/* Undoes contended_register(), if it was done.
+   Interrupts must be off. */
+static void
+contended_unregister (struct lock *lock)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (lock->holder != NULL)
+    {
+      list_remove (&lock->elem);
+      lock->holder = NULL;
+    }
+}
+
+/* Blocks the current thread on LOCK's waiters list until woken
+   by wake_waiters(), donating to LOCK's holder, if known.  If
+   LOCK belongs to readers-writer lock RW and has no holder, RW
+   is held for reading and the donation goes to its readers
+   instead.  Interrupts must be off. */
+static void
+contended_wait (struct lock *lock, struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  struct thread *holder = lock->holder;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  cur->wait_lock = lock;
+  cur->wait_rwlock = rw;
+  sched_trace_record (SCHED_EV_LOCK_WAIT, cur->tid,
+                      holder != NULL ? holder->tid : 0,
+                      cur->effective_priority);
+  if (holder != NULL && holder->effective_priority < cur->effective_priority)
+    thread_recursive_donate (holder, cur->effective_priority);
+  else if (holder == NULL && rw != NULL)
+    donate_readers (rw, cur->effective_priority);
+  sema_enqueue (&lock->semaphore);
+  thread_block ();
+  cur->wait_lock = NULL;
+  cur->wait_rwlock = NULL;
+}
+
+/* Readers are not linked into anything the way a lock's holder
+   is, since a reader count cannot name them.  Instead each
+   thread keeps the rwlocks it holds for reading in its
+   read_locks array.  A thread that must wait for readers finds
+   them by scanning all threads, which only happens on the
+   blocking path; set_effective_priority() looks at the waiters
+   of each rwlock in read_locks as it does for owned_locks.
+
+   A thread holding more than THREAD_READ_LOCKS rwlocks at once
+   goes untracked for the extra ones: it still works, but does
+   not receive donations through them. */
+
+/* Records that the current thread holds RW for reading.  Safe
+   with interrupts on, since only this thread writes its
+   read_locks. */
+static void
+read_hold_add (struct rwlock *rw)
+{
+  struct rwlock **read_locks = thread_current ()->read_locks;
+  int i;
+
+  for (i = 0; i < THREAD_READ_LOCKS; i++)
+    if (read_locks[i] == NULL)
+      {
+        read_locks[i] = rw;
+        return;
+      }
+}
+
+/* Undoes read_hold_add (RW). */
+static void
+read_hold_remove (struct rwlock *rw)
+{
+  struct rwlock **read_locks = thread_current ()->read_locks;
+  int i;
+
+  for (i = 0; i < THREAD_READ_LOCKS; i++)
+    if (read_locks[i] == rw)
+      {
+        read_locks[i] = NULL;
+        return;
+      }
+}
+
+/* What donate_readers() passes to donate_reader(). */
+struct reader_donation
+  {
+    struct rwlock *rw;
+    int priority;
+  };
+
+/* thread_foreach() helper that donates to T if it reads
+   AUX's rwlock. */
+static void
+donate_reader (struct thread *t, void *aux)
+{
+  struct reader_donation *d = aux;
+  int i;
+
+  for (i = 0; i < THREAD_READ_LOCKS; i++)
+    if (t->read_locks[i] == d->rw)
+      {
+        if (t->effective_priority < d->priority)
+          thread_recursive_donate (t, d->priority);
+        return;
+      }
+}
+
+/* Donates DONATE_PRIORITY to every thread holding RW for
+   reading.  Interrupts must be off. */
+static void
+donate_readers (struct rwlock *rw, int donate_priority)
+{
+  struct reader_donation d;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  d.rw = rw;
+  d.priority = donate_priority;
+  thread_foreach (donate_reader, &d);
+}
+
+/* Wakes the highest-priority thread blocked on LOCK, or all of
+   them if ALL is true, and yields if one of them should preempt
+   us.  Interrupts must be off. */
+static void
+wake_waiters (struct lock *lock, bool all)
+{
+  bool preempt = false;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (!heap_empty (&lock->semaphore.waiters))
+    {
+      struct thread *t = sema_dequeue (&lock->semaphore);
+
+      thread_unblock (t);
+      if (t->effective_priority > thread_get_priority ())
+        preempt = true;
+      if (!all)
+        break;
+    }
+  if (preempt)
+    {
+      if (intr_context ())
+        intr_yield_on_return ();
+      else
+        thread_yield ();
+    }
+}
+
+/* Initializes mutex M. */
+void
+mutex_init (struct mutex *m)
+{
+  ASSERT (m != NULL);
+
+  m->owner = 0;
+  lock_init (&m->lock);
+}
+
+/* Acquires M, yielding or sleeping until it becomes available
+   if necessary.  M must not already be held by the current
+   thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+mutex_acquire (struct mutex *m)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  int spin;
+
+  ASSERT (m != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!mutex_held_by_current_thread (m));
+
+  for (spin = 0; spin <= SPIN_CNT; spin++)
+    {
+      if (mutex_try_acquire (m))
+        return;
+      if (spin == SPIN_CNT || !should_spin (state_thread (m->owner)))
+        break;
+      thread_yield ();
+    }
+
+  old_level = intr_disable ();
+  while (m->owner != 0)
+    {
+      m->owner |= MUTEX_CONTENDED;
+      contended_register (&m->lock, state_thread (m->owner));
+      contended_wait (&m->lock, NULL);
+    }
+  m->owner = (uint32_t) cur;
+  if (!heap_empty (&m->lock.semaphore.waiters))
+    {
+      m->owner |= MUTEX_CONTENDED;
+      contended_register (&m->lock, cur);
+    }
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire M without sleeping and returns true if
+   successful.  M must not already be held by the current
+   thread. */
+bool
+mutex_try_acquire (struct mutex *m)
+{
+  ASSERT (m != NULL);
+  ASSERT (!mutex_held_by_current_thread (m));
+
+  return atomic_cmpxchg (&m->owner, 0, (uint32_t) thread_current ()) == 0;
+}
+
+/* Releases M, which must be held by the current thread. */
+void
+mutex_release (struct mutex *m)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (m != NULL);
+  ASSERT (mutex_held_by_current_thread (m));
+
+  if (atomic_cmpxchg (&m->owner, (uint32_t) cur, 0) == (uint32_t) cur)
+    return;
+
+  old_level = intr_disable ();
+  m->owner = 0;
+  contended_unregister (&m->lock);
+  set_effective_priority (cur);
+  wake_waiters (&m->lock, false);
+  intr_set_level (old_level);
+}
+
+/* Returns true if the current thread holds M. */
+bool
+mutex_held_by_current_thread (const struct mutex *m)
+{
+  ASSERT (m != NULL);
+
+  return state_thread (m->owner) == thread_current ();
+}
+
+/* Initializes readers-writer lock RW. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  rw->state = 0;
+  lock_init (&rw->lock);
+}
+
+/* Acquires RW for reading, sleeping while it is held for writing
+   or a writer is waiting for it. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  int spin;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  for (spin = 0; spin <= SPIN_CNT; spin++)
+    {
+      if (rwlock_try_acquire_read (rw))
+        return;
+      if (spin == SPIN_CNT || !(rw->state & RW_WRITER)
+          || !should_spin (state_thread (rw->state)))
+        break;
+      thread_yield ();
+    }
+
+  old_level = intr_disable ();
+  while (rw->state & (RW_WRITER | RW_WAITERS))
+    {
+      rw->state |= RW_WAITERS;
+      if (rw->state & RW_WRITER)
+        contended_register (&rw->lock, state_thread (rw->state));
+      contended_wait (&rw->lock, rw);
+    }
+  rw->state += RW_READER;
+  read_hold_add (rw);
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for reading without sleeping and returns
+   true if successful. */
+bool
+rwlock_try_acquire_read (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  uint32_t state = rw->state;
+  enum intr_level old_level;
+
+  if (state & (RW_WRITER | RW_WAITERS))
+    return false;
+
+  /* Record the hold first, so that a writer that blocks right
+     after our increment still finds us to donate to. */
+  read_hold_add (rw);
+  if (atomic_cmpxchg (&rw->state, state, state + RW_READER) == state)
+    return true;
+
+  /* Lost a race.  A writer may have donated to us in between. */
+  read_hold_remove (rw);
+  if (cur->effective_priority != cur->base_priority)
+    {
+      old_level = intr_disable ();
+      set_effective_priority (cur);
+      intr_set_level (old_level);
+    }
+  return false;
+}
+
+/* Releases RW, which the current thread holds for reading. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  uint32_t state = rw->state;
+  enum intr_level old_level;
+
+  ASSERT (!(state & RW_WRITER) && state >= RW_READER);
+
+  read_hold_remove (rw);
+  if (!(state & RW_WAITERS)
+      && atomic_cmpxchg (&rw->state, state, state - RW_READER) == state)
+    return;
+
+  /* Somebody is waiting, and may have donated to us. */
+  old_level = intr_disable ();
+  rw->state -= RW_READER;
+  set_effective_priority (thread_current ());
+  if (rw->state == RW_WAITERS)
+    {
+      rw->state = 0;
+      wake_waiters (&rw->lock, true);
+    }
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping while it has other
+   holders.  RW must not already be held by the current
+   thread. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  int spin;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_for_write (rw));
+
+  for (spin = 0; spin <= SPIN_CNT; spin++)
+    {
+      if (rwlock_try_acquire_write (rw))
+        return;
+      if (spin == SPIN_CNT || !(rw->state & RW_WRITER)
+          || !should_spin (state_thread (rw->state)))
+        break;
+      thread_yield ();
+    }
+
+  old_level = intr_disable ();
+  while (rw->state & ~RW_WAITERS)
+    {
+      rw->state |= RW_WAITERS;
+      if (rw->state & RW_WRITER)
+        contended_register (&rw->lock, state_thread (rw->state));
+      contended_wait (&rw->lock, rw);
+    }
+  rw->state = (uint32_t) cur | RW_WRITER;
+  if (!heap_empty (&rw->lock.semaphore.waiters))
+    {
+      rw->state |= RW_WAITERS;
+      contended_register (&rw->lock, cur);
+    }
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for writing without sleeping and returns
+   true if successful. */
+bool
+rwlock_try_acquire_write (struct rwlock *rw)
+{
+  uint32_t writer = (uint32_t) thread_current () | RW_WRITER;
+
+  return atomic_cmpxchg (&rw->state, 0, writer) == 0;
+}
+
+/* Releases RW, which the current thread holds for writing. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  uint32_t writer = (uint32_t) cur | RW_WRITER;
+  enum intr_level old_level;
+
+  ASSERT (rwlock_held_for_write (rw));
+
+  if (atomic_cmpxchg (&rw->state, writer, 0) == writer)
+    return;
+
+  old_level = intr_disable ();
+  rw->state = 0;
+  contended_unregister (&rw->lock);
+  set_effective_priority (cur);
+  wake_waiters (&rw->lock, true);
+  intr_set_level (old_level);
+}
+
+/* Returns true if the current thread holds RW for writing. */
+bool
+rwlock_held_for_write (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return ((rw->state & RW_WRITER)
+          && state_thread (rw->state) == thread_current ());
+}
+
+/* One semaphore in a condition's waiters. */
 struct semaphore_elem
   {
-    struct list_elem elem;              /* List element. */
+    struct heap_elem elem;              /* Heap element. */
     struct semaphore semaphore;         /* This semaphore. */
-    int priority;                       /* Blocked thread's priority. */
+    struct thread *thread;              /* Waiting thread. */
   };
 
+/* Compares the effective priorities of the threads waiting on
+   condition waiters A and B.  The waiting threads' wait_queue
+   points to the condition, so donations keep this order up to
+   date. */
+static bool
+cond_waiter_less (const struct heap_elem *a, const struct heap_elem *b,
+                  void *aux UNUSED)
+{
+  struct semaphore_elem *sa = heap_entry (a, struct semaphore_elem, elem);
+  struct semaphore_elem *sb = heap_entry (b, struct semaphore_elem, elem);
+  return sa->thread->effective_priority < sb->thread->effective_priority;
+}
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -337,16 +907,7 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
-}
-
-/* list_insert_ordered () helper function for cond preemption support. */
-static bool
-cond_priority_greater (const struct list_elem *a, const struct list_elem *b, void *aux UNUSED) 
-{
-  struct semaphore_elem *sa = list_entry (a, struct semaphore_elem, elem);
-  struct semaphore_elem *sb = list_entry (b, struct semaphore_elem, elem);
-  return sa->priority > sb->priority;
+  heap_init (&cond->waiters, cond_waiter_less, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -373,15 +934,21 @@ void
 cond_wait (struct condition *cond, struct lock *lock)
 {
   struct semaphore_elem waiter;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  waiter.priority = thread_get_priority ();
+  waiter.thread = cur;
   sema_init (&waiter.semaphore, 0);
-  list_insert_ordered (&cond->waiters, &waiter.elem, cond_priority_greater, NULL);
+  old_level = intr_disable ();
+  heap_push (&cond->waiters, &waiter.elem);
+  cur->wait_queue = &cond->waiters;
+  cur->wait_node = &waiter.elem;
+  intr_set_level (old_level);
   lock_release (lock);
   sema_down (&waiter.semaphore);
   lock_acquire (lock);
@@ -397,14 +964,24 @@ cond_wait (struct condition *cond, struct lock *lock)
 void
 cond_signal (struct condition *cond, struct lock *lock UNUSED)
 {
+  enum intr_level old_level;
+
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters))
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+  old_level = intr_disable ();
+  if (!heap_empty (&cond->waiters))
+    {
+      struct semaphore_elem *waiter;
+
+      waiter = heap_entry (heap_pop (&cond->waiters),
+                           struct semaphore_elem, elem);
+      waiter->thread->wait_queue = NULL;
+      sema_up (&waiter->semaphore);
+    }
+  intr_set_level (old_level);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -419,6 +996,6 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
 
-  while (!list_empty (&cond->waiters))
+  while (!heap_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
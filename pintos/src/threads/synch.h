@@ -1,14 +1,16 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, by priority. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -16,7 +18,7 @@ void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
-bool waiters_max_priority (const struct list_elem *a, const struct list_elem *b, void *aux);
+int sema_waiters_priority (const struct semaphore *);
 
 /* Lock. */
 struct lock
@@ -32,10 +34,54 @@ bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Adaptive lock.
+
+   Same rules as a lock, but an uncontended acquire or release is
+   a single atomic instruction on OWNER: interrupts stay on and
+   no donation bookkeeping is done.  A contended acquire first
+   yields a few times to a ready holder, then blocks.  Only
+   then is the embedded LOCK linked into the holder's
+   owned_locks, so that priority donation works as for locks. */
+struct mutex
+  {
+    uint32_t owner;             /* Holder, plus MUTEX_CONTENDED. */
+    struct lock lock;           /* Donation bookkeeping and waiters. */
+  };
+
+void mutex_init (struct mutex *);
+void mutex_acquire (struct mutex *);
+bool mutex_try_acquire (struct mutex *);
+void mutex_release (struct mutex *);
+bool mutex_held_by_current_thread (const struct mutex *);
+
+/* Readers-writer lock.
+
+   Any number of readers or a single writer.  STATE holds either
+   the reader count or the writing thread, as for struct mutex
+   an uncontended acquire or release is one atomic instruction,
+   and contended callers block in the embedded LOCK.  Waiting
+   writers keep new readers out.  Blocked threads donate their
+   priority to the writer, as to a lock's holder, or else to
+   every reader. */
+struct rwlock
+  {
+    uint32_t state;             /* Readers or writer, plus flags. */
+    struct lock lock;           /* Donation bookkeeping and waiters. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
 /* Condition variable. */
 struct condition
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, by priority. */
   };
 
 void cond_init (struct condition *);
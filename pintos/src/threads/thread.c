@@ -12,6 +12,7 @@
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "devices/timer.h"
 
 #ifdef USERPROG
@@ -59,6 +60,20 @@ static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
 
+/* Cache of pages freed by dead threads, reused by
+   thread_create() so that spawning a thread usually costs
+   neither a trip to the page allocator nor zeroing a page: only
+   the struct thread at the bottom is cleared, by init_thread().
+   The pages are linked through their allelem members.  Accessed
+   only with interrupts off, since pages are returned from
+   thread_schedule_tail(). */
+#define THREAD_CACHE_MAX 16     /* Max # of cached pages. */
+static struct list thread_cache;
+static size_t thread_cache_cnt;
+static long long thread_cache_hits;     /* Pages reused. */
+static long long thread_cache_misses;   /* Pages from palloc. */
+static long long thread_cache_frees;    /* Pages back to palloc. */
+
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
@@ -68,6 +83,11 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+#ifdef USERPROG
+/* Cache of `struct wait_status'. */
+struct kmem_cache *wait_status_cache;
+#endif
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -76,10 +96,15 @@ static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
+static struct thread *thread_page_alloc (void);
+static void thread_page_free (struct thread *);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
 static int thread_get_base_priority (void);
+#ifdef USERPROG
+static bool init_children (struct thread *);
+#endif
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -102,6 +127,7 @@ thread_init (void)
   lock_init (&tid_lock);
   list_init (&ready_list);
   list_init (&all_list);
+  list_init (&thread_cache);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -116,6 +142,14 @@ thread_init (void)
 void
 thread_start (void)
 {
+#ifdef USERPROG
+  wait_status_cache = kmem_cache_create ("wait_status",
+                                         sizeof (struct wait_status), 0,
+                                         NULL);
+  if (!init_children (initial_thread))
+    PANIC ("thread_start: out of memory");
+#endif
+
   /* Create the idle thread. */
   struct semaphore idle_started;
   sema_init (&idle_started, 0);
@@ -172,6 +206,10 @@ thread_print_stats (void)
 {
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  printf ("Thread: %lld pages reused, %lld allocated, %lld freed, "
+          "%zu cached\n", thread_cache_hits, thread_cache_misses,
+          thread_cache_frees, thread_cache_cnt);
+  sched_trace_dump ();
 }
 
 #ifdef USERPROG
@@ -182,9 +220,35 @@ init_wait_status (struct wait_status *ws, tid_t tid)
   lock_acquire (&ws->lock);
   ws->ref_cnt = 2;
   lock_release (&ws->lock);
+  ws->parent = thread_current ();
   ws->tid = tid;
+  ws->exit_code = -1;
   sema_init (&ws->dead, 0);
 }
+
+/* Returns a hash value for wait_status E. */
+static unsigned
+wait_status_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct wait_status, hash_elem)->tid);
+}
+
+/* Returns true if wait_status A's tid is less than B's. */
+static bool
+wait_status_less (const struct hash_elem *a, const struct hash_elem *b,
+                  void *aux UNUSED)
+{
+  return (hash_entry (a, struct wait_status, hash_elem)->tid
+          < hash_entry (b, struct wait_status, hash_elem)->tid);
+}
+
+/* Sets up T's table of children.  Returns true if successful,
+   false if memory is exhausted. */
+static bool
+init_children (struct thread *t)
+{
+  return hash_init (&t->children, wait_status_hash, wait_status_less, NULL);
+}
 #endif
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -213,13 +277,12 @@ thread_create (const char *name, int priority,
   tid_t tid;
 #ifdef USERPROG
   struct wait_status *ws;
-  bool free_cws;
 #endif
 
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = thread_page_alloc ();
   if (t == NULL)
     return TID_ERROR;
 
@@ -229,12 +292,23 @@ thread_create (const char *name, int priority,
   tid = t->tid =  allocate_tid ();
 
 #ifdef USERPROG
-  t->wait_status = ws = (struct wait_status*) malloc (sizeof(struct wait_status));
-  if (ws == NULL)
-    return -1;
+  t->wait_status = ws = kmem_cache_alloc (wait_status_cache);
+  if (ws == NULL || !init_children (t))
+    {
+      /* T never ran, so take it off all_list and give back its
+         page here. */
+      enum intr_level old_level;
+
+      if (ws != NULL)
+        kmem_cache_free (wait_status_cache, ws);
+      old_level = intr_disable ();
+      list_remove (&t->allelem);
+      thread_page_free (t);
+      intr_set_level (old_level);
+      return TID_ERROR;
+    }
   init_wait_status (ws, tid);
-  list_push_back (&thread_current ()->children, &t->wait_status->elem);
-  
+  hash_insert (&thread_current ()->children, &ws->hash_elem);
 #endif
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
@@ -264,26 +338,6 @@ thread_create (const char *name, int priority,
     thread_yield ();
   }
 
-#ifdef USERPROG
-  if (strcmp (name, "idle")) {
-    sema_down (&ws->dead);
-    tid = ws->tid;
-    if (tid == -1) {
-      list_remove (&ws->elem);
-      lock_acquire (&ws->lock);
-      ws->ref_cnt--;
-      if (ws->ref_cnt == 0) {
-        free_cws = true;
-      }
-      lock_release (&ws->lock);
-      if (free_cws) {
-        free (ws);
-      }
-   }
-  }
-  /* after child's load finish */
-#endif
-
   return tid;
 }
 
@@ -300,6 +354,7 @@ thread_block (void)
   ASSERT (intr_get_level () == INTR_OFF);
 
   thread_current ()->status = THREAD_BLOCKED;
+  sched_hist_block (&thread_current ()->sched_hist);
   schedule ();
 }
 
@@ -323,6 +378,8 @@ thread_unblock (struct thread *t)
   t->status = THREAD_READY;
   t->wakeup_time = 0;
   list_insert_ordered (&ready_list, &t->elem, priority_greater, NULL);
+  sched_hist_wakeup (&t->sched_hist);
+  sched_trace_record (SCHED_EV_WAKEUP, t->tid, 0, t->effective_priority);
   intr_set_level (old_level);
 }
 
@@ -394,6 +451,7 @@ thread_yield (void)
   if (cur != idle_thread)
     list_insert_ordered (&ready_list, &cur->elem, priority_greater, NULL);
   cur->status = THREAD_READY;
+  sched_hist_ready (&cur->sched_hist);
   schedule ();
   intr_set_level (old_level);
 }
@@ -434,15 +492,26 @@ set_effective_priority (struct thread *t)
 {
   struct list_elem *e;
   int max_donate_priority = PRI_MIN;
+  int i;
   for (e = list_begin (&t->owned_locks);
       e != list_end (&t->owned_locks); e = list_next (e)) {
     struct lock *lock = list_entry (e, struct lock, elem);
-    struct list_elem *t = list_max (&lock->semaphore.waiters, waiters_max_priority, NULL);
-    int priority = list_entry (t, struct thread, elem)->effective_priority;
+    int priority = sema_waiters_priority (&lock->semaphore);
     max_donate_priority = max_donate_priority > priority ? max_donate_priority : priority;
   }
+  /* Waiters of an rwlock held for reading donate to every reader. */
+  for (i = 0; i < THREAD_READ_LOCKS; i++) {
+    if (t->read_locks[i] == NULL)
+      continue;
+    int priority = sema_waiters_priority (&t->read_locks[i]->lock.semaphore);
+    max_donate_priority = max_donate_priority > priority ? max_donate_priority : priority;
+  }
+  int old_priority = t->effective_priority;
   t->effective_priority = t->base_priority > max_donate_priority ?
                           t->base_priority : max_donate_priority;
+  /* Keep the heap T waits in ordered. */
+  if (t->wait_queue != NULL && t->effective_priority != old_priority)
+    heap_update (t->wait_queue, t->wait_node);
 }
 
 
@@ -505,12 +574,13 @@ idle (void *idle_started_ UNUSED)
   struct semaphore *idle_started = idle_started_;
   idle_thread = thread_current ();
   sema_up (idle_started);
-#ifdef USERPROG
-  sema_up (&idle_thread->wait_status->dead);
-#endif
 
   for (;;)
     {
+      /* Zero free pages ahead of PAL_ZERO requests while there is
+         nothing else to do. */
+      palloc_prezero ();
+
       /* Let someone else run. */
       intr_disable ();
       thread_block ();
@@ -584,7 +654,10 @@ init_thread (struct thread *t, const char *name, int priority)
   t->magic = THREAD_MAGIC;
 #ifdef USERPROG
   /* init new components of struct thread */
-  list_init (&t->children);
+  list_init (&t->exited_children);
+  lock_init (&t->exited_lock);
+  sema_init (&t->child_exits, 0);
+  fd_table_init (&t->fds);
 #endif
 
   old_level = intr_disable ();
@@ -662,7 +735,60 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread)
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      thread_page_free (prev);
+    }
+}
+
+/* Returns a page for a new thread, from the thread cache if
+   possible, or a null pointer if memory is exhausted.  Only the
+   page's struct thread may be relied upon to be cleared, by
+   init_thread(). */
+static struct thread *
+thread_page_alloc (void)
+{
+  struct thread *t = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (!list_empty (&thread_cache))
+    {
+      t = list_entry (list_pop_front (&thread_cache), struct thread, allelem);
+      thread_cache_cnt--;
+      thread_cache_hits++;
+    }
+  intr_set_level (old_level);
+
+  if (t == NULL)
+    {
+      t = palloc_get_page (0);
+      if (t != NULL)
+        {
+          old_level = intr_disable ();
+          thread_cache_misses++;
+          intr_set_level (old_level);
+        }
+    }
+  return t;
+}
+
+/* Returns the page of dead thread T to the thread cache, or to
+   the page allocator if the cache is full.
+   Interrupts must be off. */
+static void
+thread_page_free (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_cache_cnt < THREAD_CACHE_MAX)
+    {
+      t->magic = 0;
+      list_push_front (&thread_cache, &t->allelem);
+      thread_cache_cnt++;
+    }
+  else
+    {
+      thread_cache_frees++;
+      palloc_free_page (t);
     }
 }
 
@@ -685,7 +811,12 @@ schedule (void)
   ASSERT (is_thread (next));
 
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      sched_hist_run (&next->sched_hist);
+      sched_trace_record (SCHED_EV_SWITCH, next->tid, cur->tid,
+                          next->effective_priority);
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
@@ -2,10 +2,15 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
 #include <stdint.h>
 #include "threads/synch.h"
 #include "threads/fixed-point.h"
+#include "threads/sched-trace.h"
+#ifdef USERPROG
+#include "userprog/fd-table.h"
+#endif
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -16,7 +21,9 @@ enum thread_status
     THREAD_DYING        /* About to be destroyed. */
   };
 
-#define MAX_OPEN_FILES 128
+/* Rwlocks a thread can hold for reading at once and still
+   receive priority donations through (see synch.c). */
+#define THREAD_READ_LOCKS 4
 
 /* Thread identifier type.
    You can redefine this to whatever type you like. */
@@ -29,14 +36,21 @@ typedef int tid_t;
 #define PRI_MAX 63                      /* Highest priority. */
 
 #ifdef USERPROG
+struct thread;
+
+/* A child process's exit status, shared by the child and its
+   parent, and freed by whichever lets go of it last. */
 struct wait_status
    {
-      struct list_elem elem;
-      struct lock lock;
-      int ref_cnt;
-      tid_t tid;
-      int exit_code;
-      struct semaphore dead;
+      struct hash_elem hash_elem;       /* Element in parent's `children'. */
+      struct list_elem exit_elem;       /* Element in parent's
+                                           `exited_children'. */
+      struct thread *parent;            /* Parent, while ref_cnt is 2. */
+      struct lock lock;                 /* Guards ref_cnt. */
+      int ref_cnt;                      /* 2 = child and parent alive. */
+      tid_t tid;                        /* Child's thread id. */
+      int exit_code;                    /* Child's exit status. */
+      struct semaphore dead;            /* Upped when the child exits. */
    };
 #endif
 
@@ -91,11 +105,18 @@ struct wait_status
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
 /* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
+   the run queue (thread.c), or it can be an element in the
+   sleeping threads list (timer.c).  It can be used these two ways
    only because they are mutually exclusive: only a thread in the
    ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+   blocked state is on the sleep list.  Semaphore waiters are kept
+   in a priority heap instead, through `wait_elem'.
+
+   `wait_queue' and `wait_node' name the heap a blocked thread is
+   ordered in, so that a priority donation can move it up.  That
+   is normally a semaphore's waiters and `wait_elem', but a
+   thread in cond_wait() is ordered by its entry in the
+   condition's waiters instead. */
 struct thread
   {
     /* Owned by thread.c. */
@@ -110,6 +131,9 @@ struct thread
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
+    struct heap_elem wait_elem;         /* Semaphore waiters element. */
+    struct heap *wait_queue;            /* Heap this thread waits in. */
+    struct heap_elem *wait_node;        /* Our element in wait_queue. */
 
     /* Used by timer_sleep() */
     int64_t wakeup_time;                /* Time when this thread wakes up. 0 if it is awake. */
@@ -117,17 +141,43 @@ struct thread
     struct list owned_locks;            /* Locks owned by current thread. */
 
     struct lock *wait_lock;             /* Lock that current thread is waiting. */
+    struct rwlock *wait_rwlock;         /* Rwlock owning wait_lock, if any. */
+    struct rwlock *read_locks[THREAD_READ_LOCKS]; /* Rwlocks held for reading. */
+
+    struct sched_hist sched_hist;       /* Latency histograms (sched-trace.c). */
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
 
     /* Modification below */
-    struct list children;               /* List of child threads' wait_status */
+    struct hash children;               /* Children's wait_status, by tid. */
+    struct list exited_children;        /* Children that have exited but
+                                           not been waited for. */
+    struct lock exited_lock;            /* Guards exited_children. */
+    struct semaphore child_exits;       /* Upped once per child added to
+                                           exited_children. */
     struct wait_status *wait_status;    /* This thread's wait_status (using malloc) */
-    struct FILE *open_files[MAX_OPEN_FILES];    /* Files this thread has opened */
+    struct fd_table fds;                /* Files this thread has opened */
     struct file *this_executable;       /* File of this executable, if this thread is loaded from a executable */
     struct dir *cwd;
+    struct console_line *console_line;  /* Output to fd 1 not yet written
+                                           out, or null. */
+#endif
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;                  /* Supplemental page table. */
+    struct list pinned_pages;           /* Pages pinned by a system call. */
+    void *user_esp;                     /* User stack pointer on entry
+                                           to the current system call. */
+
+    /* Owned by vm/brk.c. */
+    void *heap_start;                   /* Start of heap. */
+    void *brk;                          /* End of heap. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
 #endif
 
     /* Owned by thread.c. */
@@ -139,6 +189,11 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+#ifdef USERPROG
+/* Cache of `struct wait_status'. */
+extern struct kmem_cache *wait_status_cache;
+#endif
+
 
 void thread_init (void);
 void thread_start (void);
@@ -4,7 +4,12 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 #include "userprog/syscall.h"
+#include "userprog/uaccess.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -149,9 +154,32 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+  /* Bring in the page, if the process has one there, or grow the
+     stack to cover FAULT_ADDR if it looks like a stack access.
+     Faults on user addresses in kernel context are handled the
+     same way, so that system calls may touch pages not yet read
+     in; the user stack pointer is then the one saved on entry to
+     the system call. */
+  if (not_present && is_user_vaddr (fault_addr))
+    {
+      const void *esp = user ? f->esp : thread_current ()->user_esp;
+
+      if (page_in (fault_addr)
+          || (page_grow_stack (fault_addr, esp) && page_in (fault_addr)))
+        return;
+    }
+#endif
+
    if (user) {
       syscall_exit (-1);
    }
+
+  /* A kernel access to user memory through one of the functions
+     in uaccess.c fails instead of panicking. */
+  if (uaccess_fixup (f))
+    return;
+
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
      which fault_addr refers. */
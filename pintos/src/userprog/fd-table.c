@@ -0,0 +1,172 @@
+#include "userprog/fd-table.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+
+/* File descriptor tables.
+
+   Descriptors 0 and 1 are the console and have no slot; the
+   file opened as descriptor FD is in slot FD - FD_FIRST.  The
+   slots live in an array allocated apart from the thread, which
+   starts out empty and doubles in size whenever it fills up, to
+   at most FD_MAX slots.
+
+   A new file gets the lowest free descriptor, as in Unix.  A
+   bitmap of the slots in use, searched a word at a time, finds
+   it, starting from a hint below which every slot is known to
+   be taken, so that opening many files in a row does not search
+   from the start each time. */
+
+/* First descriptor with a slot. */
+#define FD_FIRST 2
+
+/* Initial number of slots. */
+#define FD_INIT_SIZE 16
+
+/* Bits in a bitmap word. */
+#define WORD_BITS 32
+
+/* Number of bitmap words for SIZE slots. */
+#define WORD_CNT(SIZE) (((SIZE) + WORD_BITS - 1) / WORD_BITS)
+
+/* Initializes T as an empty table.  Allocates nothing. */
+void
+fd_table_init (struct fd_table *t)
+{
+  t->files = NULL;
+  t->used = NULL;
+  t->size = 0;
+  t->next = 0;
+}
+
+/* Closes every file in T and frees its memory. */
+void
+fd_table_destroy (struct fd_table *t)
+{
+  size_t slot;
+
+  for (slot = 0; slot < t->size; slot++)
+    if (t->files[slot] != NULL)
+      filesys_close (t->files[slot]);
+  free (t->files);
+  free (t->used);
+  fd_table_init (t);
+}
+
+/* Doubles the number of slots in T.  Returns true if successful,
+   false if T is as large as it may get or memory is exhausted. */
+static bool
+grow (struct fd_table *t)
+{
+  size_t new_size = t->size == 0 ? FD_INIT_SIZE : t->size * 2;
+  struct FILE **files;
+  uint32_t *used;
+
+  if (new_size > FD_MAX)
+    return false;
+
+  files = realloc (t->files, new_size * sizeof *files);
+  if (files == NULL)
+    return false;
+  t->files = files;
+  used = realloc (t->used, WORD_CNT (new_size) * sizeof *used);
+  if (used == NULL)
+    return false;
+  t->used = used;
+
+  memset (files + t->size, 0, (new_size - t->size) * sizeof *files);
+  memset (used + WORD_CNT (t->size), 0,
+          (WORD_CNT (new_size) - WORD_CNT (t->size)) * sizeof *used);
+  t->size = new_size;
+  return true;
+}
+
+/* Returns the lowest free slot in T at or above T->next, or
+   T->size if every slot is in use. */
+static size_t
+find_free (const struct fd_table *t)
+{
+  size_t word;
+
+  for (word = t->next / WORD_BITS; word < WORD_CNT (t->size); word++)
+    if (t->used[word] != UINT32_MAX)
+      {
+        size_t slot = word * WORD_BITS + __builtin_ctz (~t->used[word]);
+        return slot < t->size ? slot : t->size;
+      }
+  return t->size;
+}
+
+/* Adds F to T under the lowest free descriptor and returns the
+   descriptor.  Returns -1 if T is full or memory is exhausted. */
+int
+fd_table_add (struct fd_table *t, struct FILE *f)
+{
+  size_t slot;
+
+  ASSERT (f != NULL);
+
+  slot = find_free (t);
+  if (slot == t->size && !grow (t))
+    return -1;
+
+  t->files[slot] = f;
+  t->used[slot / WORD_BITS] |= (uint32_t) 1 << (slot % WORD_BITS);
+  t->next = slot + 1;
+  return slot + FD_FIRST;
+}
+
+/* Adds F to T under descriptor FD, which must not be in use.
+   Returns true if successful, false if FD is in use or is not a
+   descriptor T may hold, or if memory is exhausted. */
+bool
+fd_table_install (struct fd_table *t, int fd, struct FILE *f)
+{
+  size_t slot;
+
+  ASSERT (f != NULL);
+
+  if (fd < FD_FIRST || fd - FD_FIRST >= FD_MAX)
+    return false;
+  slot = fd - FD_FIRST;
+  while (slot >= t->size)
+    if (!grow (t))
+      return false;
+  if (t->files[slot] != NULL)
+    return false;
+
+  t->files[slot] = f;
+  t->used[slot / WORD_BITS] |= (uint32_t) 1 << (slot % WORD_BITS);
+  return true;
+}
+
+/* Returns the file with descriptor FD in T, or a null pointer if
+   FD is not open or is a console descriptor. */
+struct FILE *
+fd_table_get (const struct fd_table *t, int fd)
+{
+  if (fd < FD_FIRST || (size_t) (fd - FD_FIRST) >= t->size)
+    return NULL;
+  return t->files[fd - FD_FIRST];
+}
+
+/* Removes the file with descriptor FD from T and returns it, or
+   returns a null pointer if FD is not open.  Does not close the
+   file. */
+struct FILE *
+fd_table_remove (struct fd_table *t, int fd)
+{
+  struct FILE *f = fd_table_get (t, fd);
+
+  if (f != NULL)
+    {
+      size_t slot = fd - FD_FIRST;
+      t->files[slot] = NULL;
+      t->used[slot / WORD_BITS] &= ~((uint32_t) 1 << (slot % WORD_BITS));
+      if (slot < t->next)
+        t->next = slot;
+    }
+  return f;
+}
@@ -0,0 +1,29 @@
+#ifndef USERPROG_FD_TABLE_H
+#define USERPROG_FD_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct FILE;
+
+/* Maximum number of files a process may have open at once. */
+#define FD_MAX 8192
+
+/* A process's file descriptor table.  See fd-table.c. */
+struct fd_table
+  {
+    struct FILE **files;        /* Open files, indexed by slot. */
+    uint32_t *used;             /* Bitmap of slots in use. */
+    size_t size;                /* Number of slots. */
+    size_t next;                /* No free slot below this one. */
+  };
+
+void fd_table_init (struct fd_table *);
+void fd_table_destroy (struct fd_table *);
+int fd_table_add (struct fd_table *, struct FILE *);
+bool fd_table_install (struct fd_table *, int fd, struct FILE *);
+struct FILE *fd_table_get (const struct fd_table *, int fd);
+struct FILE *fd_table_remove (struct fd_table *, int fd);
+
+#endif /* userprog/fd-table.h */
@@ -1,4 +1,5 @@
 #include "userprog/process.h"
+#include <console.h>
 #include <debug.h>
 #include <inttypes.h>
 #include <round.h>
@@ -7,10 +8,12 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
@@ -19,66 +22,172 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#ifdef VM
+#include "vm/brk.h"
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
+
+/* Handed to start_process() to say what to run.
+
+   process_execute() passes one on its own stack and waits on
+   LOADED, so ARGS stays valid until the child has copied it onto
+   its own stack.  process_spawn() does not wait; the child owns
+   its exec_info, which is allocated with malloc(), and ARGS,
+   which is a page, and frees both once loaded. */
+struct exec_info
+  {
+    const char *args;           /* Command line, or packed argv. */
+    size_t args_len;            /* Bytes in ARGS, with the last null. */
+    bool packed;                /* ARGS holds argv's strings, back to
+                                   back, rather than a command line? */
+
+    /* process_execute() only. */
+    struct semaphore loaded;    /* Upped once the load is done. */
+    bool success;               /* Did the load succeed? */
+
+    /* process_spawn() only. */
+    bool spawned;               /* Started by process_spawn()? */
+    size_t file_cnt;            /* Number of files. */
+    struct spawn_file files[];  /* Files to give the new process. */
+  };
 
-static struct semaphore temporary;
 static thread_func start_process NO_RETURN;
-static bool load (const char *cmdline, void (**eip) (void), void **esp);
+static bool load (const struct exec_info *, void (**eip) (void), void **esp);
 
 /* the file system lock from syscall.c */
 extern struct lock fs_lock;
 
+/* Copies the program name at the start of ARGS, as described by
+   `struct exec_info', into the SIZE bytes at NAME, truncating it
+   if need be.  Returns false if ARGS names no program. */
+static bool
+get_program_name (char *name, size_t size, const char *args, bool packed)
+{
+  size_t i;
+
+  if (!packed)
+    while (*args == ' ')
+      args++;
+  if (*args == '\0')
+    return false;
+  for (i = 0; args[i] != '\0' && (packed || args[i] != ' ') && i < size - 1;
+       i++)
+    name[i] = args[i];
+  name[i] = '\0';
+  return true;
+}
+
 /* Starts a new thread running a user program loaded from
-   FILENAME.  The new thread may be scheduled (and may even exit)
-   before process_execute() returns.  Returns the new process's
-   thread id, or TID_ERROR if the thread cannot be created. */
+   CMD_LINE, whose first word is the program's file name and the
+   rest its arguments.  Waits for the program to be loaded, but
+   the new process may be scheduled (and may even exit) before
+   process_execute() returns.  Returns the new process's thread
+   id, or TID_ERROR if the thread cannot be created or the
+   program cannot be loaded. */
 tid_t
-process_execute (const char *file_name)
+process_execute (const char *cmd_line)
 {
-  int i;
-  char *fn_copy;
-  char *p;
+  struct exec_info exec;
+  char name[16];
   tid_t tid;
-  const int MAX_NAME_LEN = 16;
-  char process_name[MAX_NAME_LEN]; // process name can have 16 bytes most
-  
-  sema_init (&temporary, 0);
-  /* Make a copy of FILE_NAME.
-     Otherwise there's a race between the cstack_sizeer and load(). */
-  fn_copy = palloc_get_page (0);
-  if (fn_copy == NULL)
-    return TID_ERROR;
-  strlcpy (fn_copy, file_name, PGSIZE);
-  
-  /*
-    Before creating the thread, we need to find the program name from file_name and use it as the thread's name.
-  */
-  
-  for (p = fn_copy; *p == ' '; ++p) ;
-  if (*p == '\0') {
-    printf("PROCESS: name error");
+
+  /* Name the thread after the program. */
+  if (!get_program_name (name, sizeof name, cmd_line, false))
     return TID_ERROR;
-  }
-  for (i = 0; *p != '\0' && *p != ' ' && i < MAX_NAME_LEN-1; ++p) {
-    process_name[i++] = *p;
-  }
-  process_name[i] = '\0';
 
-  /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (process_name, PRI_DEFAULT, start_process, fn_copy);
-  
+  /* Create a new thread to execute CMD_LINE and wait for it to
+     be loaded. */
+  exec.args = cmd_line;
+  exec.args_len = strlen (cmd_line) + 1;
+  exec.packed = false;
+  sema_init (&exec.loaded, 0);
+  exec.success = false;
+  exec.spawned = false;
+  exec.file_cnt = 0;
+  tid = thread_create (name, PRI_DEFAULT, start_process, &exec);
+  if (tid != TID_ERROR)
+    {
+      sema_down (&exec.loaded);
+      if (!exec.success)
+        {
+          /* Reap the child, which is on its way out. */
+          process_wait (tid);
+          tid = TID_ERROR;
+        }
+    }
+  return tid;
+}
+
+/* Starts a new thread running a user program, without waiting
+   for it to be loaded.  ARGS is a page, obtained with
+   palloc_get_page(), that holds the ARGS_LEN bytes of the
+   program's null-terminated arguments, one after another; the
+   first is the program's file name.  The new process gets each
+   of the FILE_CNT FILES under the descriptor given with it.
+
+   Takes ownership of ARGS and FILES whether or not it succeeds.
+   If the program cannot be loaded, or a file cannot be given
+   its descriptor, the new process exits with status -1.
+   Returns the new process's thread id, or TID_ERROR if the
+   thread cannot be created. */
+tid_t
+process_spawn (char *args, size_t args_len,
+               const struct spawn_file *files, size_t file_cnt)
+{
+  struct exec_info *exec;
+  char name[16];
+  tid_t tid = TID_ERROR;
+  size_t i;
+
+  exec = malloc (sizeof *exec + file_cnt * sizeof *exec->files);
+  if (exec != NULL && get_program_name (name, sizeof name, args, true))
+    {
+      exec->args = args;
+      exec->args_len = args_len;
+      exec->packed = true;
+      exec->spawned = true;
+      exec->file_cnt = file_cnt;
+      memcpy (exec->files, files, file_cnt * sizeof *files);
+      tid = thread_create (name, PRI_DEFAULT, start_process, exec);
+    }
+  if (tid == TID_ERROR)
+    {
+      for (i = 0; i < file_cnt; i++)
+        filesys_close (files[i].file);
+      free (exec);
+      palloc_free_page (args);
+    }
   return tid;
 }
 
+/* Gives the current process the files of EXEC, which was
+   started by process_spawn().  Returns true if successful, false
+   if some file could not be given its descriptor, in which case
+   that file and those after it are closed. */
+static bool
+install_files (const struct exec_info *exec)
+{
+  struct fd_table *fds = &thread_current ()->fds;
+  size_t i;
+
+  for (i = 0; i < exec->file_cnt; i++)
+    if (!fd_table_install (fds, exec->files[i].fd, exec->files[i].file))
+      {
+        for (; i < exec->file_cnt; i++)
+          filesys_close (exec->files[i].file);
+        return false;
+      }
+  return true;
+}
+
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process (void *file_name_)
+start_process (void *exec_)
 {
-  int i;
-  int argc = 1;
-  int stack_size = 0;
-  char *arg;
-  char *file_name, *cmd = file_name_;
+  struct exec_info *exec = exec_;
   struct intr_frame if_;
   bool success;
 
@@ -88,78 +197,31 @@ start_process (void *file_name_)
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
 
-  /* extract prog_name and following arguments from file_name */
-  file_name = strtok_r (cmd, " ", &cmd);
-  if (file_name == NULL) {
-    //should never be the case. Error in thread_excecute
-    success = false;
-    goto DONE;
-  }
-
-  // printf ("%s\n", file_name);
-    
-  success = load (file_name, &if_.eip, &if_.esp);
-
-  if (success) {
-    char *p;
-    while ((arg = strtok_r (NULL, " ", &cmd)) != NULL){
-      ++argc;
-    }
-
-    int args_len[argc];
-    stack_size += argc * 4;               // length of string pointer
-    stack_size += 12;                     //length of argv, argc, RA
-
-    arg = file_name_;
-    for (i = 0; i < argc; ++i) {
-      while (*arg == ' ')
-        ++arg;
-      args_len[i] = strlen(arg);
-      stack_size += args_len[i] + 1;      // length of argv[i]
-      if_.esp -= args_len[i] + 1;
-      memcpy(if_.esp, arg, args_len[i] + 1);
-      arg += args_len[i] + 1;
+  if (exec->spawned)
+    {
+      /* Nobody waits for the load.  A failure is reported as our
+         exit status instead. */
+      success = install_files (exec) && load (exec, &if_.eip, &if_.esp);
+      palloc_free_page ((char *) exec->args);
+      free (exec);
+      if (!success)
+        syscall_exit (-1);
     }
-
-    p = (char*)if_.esp;
-
-    // stack align and argv[argc]
-    if_.esp -= 16 - stack_size % 16;
-    if_.esp -= sizeof(char*);
-    *((char **)if_.esp) = NULL;
-    // argv[i]
-    for (i = argc - 1; i >= 0; --i){
-      if_.esp -= sizeof(char*);
-      *((char **)if_.esp) = p;
-      p += args_len[i] + 1;
+  else
+    {
+      success = load (exec, &if_.eip, &if_.esp);
+
+      /* Notify the parent, which may free EXEC as soon as it
+         wakes up, and quit if the load failed. */
+      exec->success = success;
+      sema_up (&exec->loaded);
+      if (!success)
+        thread_exit ();
     }
-    // argv
-    if_.esp -= sizeof(char **);
-    *((char ***)if_.esp) = (char **)(if_.esp + sizeof(char **));
-    // argc
-    if_.esp -= sizeof(int);
-    *(int *) if_.esp = argc;
-    // RA
-    if_.esp -= sizeof(int);
-    *(int *) if_.esp = 0;
-  }
-
-
-DONE:
-  /* If load failed, notify parent process and quit. */
-  palloc_free_page (file_name_);
-  if (!success) {
-    thread_current ()->wait_status->tid = -1;
-    sema_up(&thread_current ()->wait_status->dead);
-    thread_exit ();
-  }
-
-  /* If load successed, notify parent process and execute */
-  sema_up(&thread_current ()->wait_status->dead);
 
   /* Start the user process by simulating a return from an
      interrupt, implemented by intr_exit (in
-     threads/intr-stubs.S).  Because intr_exit takes stack_size of its
+     threads/intr-stubs.S).  Because intr_exit takes all of its
      arguments on the stack in the form of a `struct intr_frame',
      we just point the stack pointer (%esp) to our stack frame
      and jump to it. */
@@ -167,48 +229,98 @@ DONE:
   NOT_REACHED ();
 }
 
+/* Drops a reference to WS, freeing it if it was the last. */
+static void
+release_wait_status (struct wait_status *ws)
+{
+  bool last;
+
+  lock_acquire (&ws->lock);
+  last = --ws->ref_cnt == 0;
+  lock_release (&ws->lock);
+  if (last)
+    kmem_cache_free (wait_status_cache, ws);
+}
+
+/* Drops the current process's reference to the wait_status
+   whose `children' element is E. */
+static void
+release_child (struct hash_elem *e, void *aux UNUSED)
+{
+  release_wait_status (hash_entry (e, struct wait_status, hash_elem));
+}
+
+/* Waits for the child whose wait_status is WS, which has been
+   taken out of the current thread's `children', to die and
+   returns its exit status, letting go of WS. */
+static int
+reap_child (struct wait_status *ws)
+{
+  struct thread *cur = thread_current ();
+  int exit_code;
+
+  /* The child adds itself to exited_children, and ups
+     child_exits, just before it ups DEAD. */
+  sema_down (&ws->dead);
+  sema_down (&cur->child_exits);
+  lock_acquire (&cur->exited_lock);
+  list_remove (&ws->exit_elem);
+  lock_release (&cur->exited_lock);
+
+  exit_code = ws->exit_code;
+  release_wait_status (ws);
+  return exit_code;
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
-   child of the cstack_sizeing process, or if process_wait() has already
-   been successfully cstack_sizeed for the given TID, returns -1
-   immediately, without waiting.
-
-   This function will be implemented in problem 2-2.  For now, it
-   does nothing. */
+   child of the calling process, or if process_wait() has already
+   been successfully called for the given TID, returns -1
+   immediately, without waiting. */
 int
 process_wait (tid_t child_tid)
 {
-  struct list_elem *e;
   struct thread *cur = thread_current ();
-  struct wait_status *cws = NULL;
-  int exit_code = -1;
-  bool free_cws = false;
-  
-  /* find the child's wait_status */
-  for (e = list_begin (&cur->children); e != list_end (&cur->children); e = list_next (e)) {
-    struct wait_status *ws = list_entry (e, struct wait_status, elem);
-    if (ws->tid == child_tid) {
-      cws = ws;
-      break;
-    }
-  }
-  if (cws == NULL)
+  struct wait_status key;
+  struct hash_elem *e;
+
+  /* Only the process itself looks at its `children'. */
+  key.tid = child_tid;
+  e = hash_delete (&cur->children, &key.hash_elem);
+  if (e == NULL)
     return -1;
+  return reap_child (hash_entry (e, struct wait_status, hash_elem));
+}
 
-  /* wait for child to exit and remove wait_status from children & destroy it */
-  sema_down (&cws->dead);
-  exit_code = cws->exit_code;
-  lock_acquire (&cws->lock);
-  cws->ref_cnt --;
-  if (cws->ref_cnt == 0)
-    free_cws = true;
-  lock_release (&cws->lock);
-  list_remove (&cws->elem);
-  if (free_cws) {
-    free (cws);
-  }
-  return exit_code;
+/* Waits for any child of the current process to die, stores its
+   exit status into *EXIT_CODE, and returns its thread id.  A
+   child that has already exited is reaped without waiting, the
+   one that exited first first.  Returns TID_ERROR immediately if
+   there is no child that has not been waited for. */
+tid_t
+process_wait_any (int *exit_code)
+{
+  struct thread *cur = thread_current ();
+  struct wait_status *ws;
+  tid_t tid;
+
+  if (hash_empty (&cur->children))
+    return TID_ERROR;
+
+  /* Wait for a child to exit, then give back the semaphore up
+     that reap_child() takes. */
+  sema_down (&cur->child_exits);
+  lock_acquire (&cur->exited_lock);
+  ws = list_entry (list_front (&cur->exited_children),
+                   struct wait_status, exit_elem);
+  lock_release (&cur->exited_lock);
+  sema_up (&cur->child_exits);
+
+  tid = ws->tid;
+  hash_delete (&cur->children, &ws->hash_elem);
+  *exit_code = reap_child (ws);
+  return tid;
 }
 
 /* Free the current process's resources. */
@@ -217,10 +329,7 @@ process_exit (void)
 {
   struct thread *cur = thread_current ();
   struct wait_status *ws = cur->wait_status;
-  struct list_elem *e;
   uint32_t *pd;
-  bool free_ws = false;
-  int i;
 
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
@@ -234,6 +343,10 @@ process_exit (void)
          directory before destroying the process's page
          directory, or our active page directory will be one
          that's been freed (and cleared). */
+#ifdef VM
+      mmap_unmap_all ();
+      page_table_destroy ();
+#endif
       cur->pagedir = NULL;
       pagedir_activate (NULL);
       pagedir_destroy (pd);
@@ -247,40 +360,36 @@ process_exit (void)
     lock_release(&fs_lock);
   }
 
-  // Reduce all children wait_status's ref_cnt, free it if ref_cnt==0
-  while (!list_empty (&cur->children)) {
-    struct list_elem *e = list_pop_front (&cur->children);
-    struct wait_status *ws = list_entry (e, struct wait_status, elem);
-    bool free_ws = false;
-    lock_acquire (&ws->lock);
-    ws->ref_cnt--;
-    if (ws->ref_cnt == 0)
-      free_ws = true;
-    lock_release (&ws->lock);
-    if (free_ws) {
-      free (ws);
+  /* Write out what is left of our console output. */
+  if (cur->console_line != NULL)
+    {
+      console_line_flush (cur->console_line);
+      free (cur->console_line);
     }
-  }
 
-  // Reduce wait_status's ref_cnt, free it if ref_cnt==0
-  lock_acquire (&ws->lock);
-  ws->ref_cnt--;
-  if (!ws->ref_cnt)
-    free_ws = true;
-  lock_release (&ws->lock);
-  if (free_ws) {
-    free (ws);
-  }
+  /* Let go of our children's exit statuses.  A child exiting
+     meanwhile may still add itself to exited_children, which
+     nobody looks at any more. */
+  hash_destroy (&cur->children, release_child);
 
   // Close opened files
-  for (i = 2; i < MAX_OPEN_FILES; ++i) {
-    if (cur->open_files[i] != NULL)
-      filesys_close (cur->open_files[i]);
-  }
+  fd_table_destroy (&cur->fds);
 
-  // Wake up a waiting parent
-  sema_up (&ws->dead);
+  /* Tell our parent, if it is still around, and let go of our
+     exit status. */
+  lock_acquire (&ws->lock);
+  if (ws->ref_cnt == 2)
+    {
+      struct thread *parent = ws->parent;
 
+      lock_acquire (&parent->exited_lock);
+      list_push_back (&parent->exited_children, &ws->exit_elem);
+      lock_release (&parent->exited_lock);
+      sema_up (&parent->child_exits);
+    }
+  lock_release (&ws->lock);
+  sema_up (&ws->dead);
+  release_wait_status (ws);
 }
 
 /* Sets up the CPU for running user code in the current
@@ -362,33 +471,74 @@ struct Elf32_Phdr
 #define PF_W 2          /* Writable. */
 #define PF_R 4          /* Readable. */
 
+/* A segment of a load plan, as passed to load_segment(). */
+struct plan_segment
+  {
+    uint32_t file_page;         /* Page-aligned offset in the file. */
+    uint32_t mem_page;          /* Page-aligned user virtual address. */
+    uint32_t read_bytes;        /* Bytes to read from the file. */
+    uint32_t zero_bytes;        /* Bytes to zero after them. */
+    bool writable;              /* Writable by the process? */
+  };
+
+/* Everything load() needs from an executable's headers, checked
+   and worked out once and then cached on the executable's inode
+   (see inode_get_load_plan()), so that executing the same
+   program again reads no headers at all. */
+struct load_plan
+  {
+    Elf32_Addr entry;           /* Entry point. */
+    size_t seg_cnt;             /* Number of segments. */
+    struct plan_segment segs[]; /* Segments to load. */
+  };
+
 static bool setup_stack (void **esp);
+static char *push_args (const char *args, size_t len, bool packed,
+                        void **esp);
+static struct load_plan *read_load_plan (struct file *);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
                           bool writable);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
+/* Loads the ELF executable named by the first argument in EXEC
+   into the current thread, with all of them as its arguments.
    Stores the executable's entry point into *EIP
    and its initial stack pointer into *ESP.
    Returns true if successful, false otherwise. */
 bool
-load (const char *file_name, void (**eip) (void), void **esp)
+load (const struct exec_info *exec, void (**eip) (void), void **esp)
 {
   struct thread *t = thread_current ();
-  struct Elf32_Ehdr ehdr;
   struct FILE *f = NULL;
   struct file *file;
-  off_t file_ofs;
+  struct load_plan *plan;
+  struct load_plan *own_plan = NULL;
+  const char *file_name;
   bool success = false;
-  int i;
+  size_t i;
+#ifdef VM
+  uint8_t *heap_start = NULL;
+#endif
 
   /* stack_sizeocate and activate page directory. */
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL)
     goto done;
+#ifdef VM
+  if (!page_table_init ())
+    goto done;
+#endif
   process_activate ();
 
+  /* Set up stack and copy the arguments onto it.  The program's
+     file name is argv[0]. */
+  if (!setup_stack (esp))
+    goto done;
+  file_name = push_args (exec->args, exec->args_len, exec->packed, esp);
+  if (file_name == NULL)
+    goto done;
+
   /* Open executable file. */
   f = filesys_open (file_name);
   if (f == NULL || f->is_dir)
@@ -405,7 +555,77 @@ load (const char *file_name, void (**eip) (void), void **esp)
   t->this_executable = file;
   lock_release(&fs_lock);
 
+  /* Find out what to load, unless an earlier load of the same
+     executable already has.  Since writes are now denied, the
+     cached plan cannot go stale while we use it.  A plan read
+     while an earlier write was still going on is not cached, so
+     it is ours to free. */
+  plan = inode_get_load_plan (file_get_inode (file));
+  if (plan == NULL)
+    {
+      struct load_plan *new_plan = read_load_plan (file);
+      if (new_plan == NULL)
+        {
+          printf ("load: %s: error loading executable\n", file_name);
+          goto done;
+        }
+      plan = inode_set_load_plan (file_get_inode (file), new_plan);
+      if (plan == NULL)
+        plan = own_plan = new_plan;
+      else if (plan != new_plan)
+        free (new_plan);
+    }
+
+  /* Load the segments. */
+  for (i = 0; i < plan->seg_cnt; i++)
+    {
+      const struct plan_segment *seg = &plan->segs[i];
+
+      if (!load_segment (file, seg->file_page, (void *) seg->mem_page,
+                         seg->read_bytes, seg->zero_bytes, seg->writable))
+        goto done;
+#ifdef VM
+      if ((uint8_t *) seg->mem_page + seg->read_bytes + seg->zero_bytes
+          > heap_start)
+        heap_start = ((uint8_t *) seg->mem_page
+                      + seg->read_bytes + seg->zero_bytes);
+#endif
+    }
+
+#ifdef VM
+  brk_init (heap_start);
+#endif
+
+  /* Start address. */
+  *eip = (void (*) (void)) plan->entry;
+
+  success = true;
+
+ done:
+  /* We arrive here whether the load is successful or not. */
+  free (own_plan);
+#ifdef VM
+  page_unpin_all ();
+#endif
+  return success;
+}
+
+/* load() helpers. */
+
+/* Reads and checks the executable header and program headers of
+   FILE and returns a load plan for it, allocated with malloc().
+   Returns a null pointer if FILE is not a valid executable or
+   memory cannot be allocated. */
+static struct load_plan *
+read_load_plan (struct file *file)
+{
+  struct Elf32_Ehdr ehdr;
+  struct load_plan *plan;
+  off_t file_ofs;
+  int i;
+
   /* Read and verify executable header. */
+  file_seek (file, 0);
   if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
       || memcmp (ehdr.e_ident, "\177ELF\1\1\1", 7)
       || ehdr.e_type != 2
@@ -413,23 +633,28 @@ load (const char *file_name, void (**eip) (void), void **esp)
       || ehdr.e_version != 1
       || ehdr.e_phentsize != sizeof (struct Elf32_Phdr)
       || ehdr.e_phnum > 1024)
-    {
-      printf ("load: %s: error loading executable\n", file_name);
-      goto done;
-    }
+    return NULL;
+
+  plan = malloc (sizeof *plan + ehdr.e_phnum * sizeof *plan->segs);
+  if (plan == NULL)
+    return NULL;
+  plan->entry = ehdr.e_entry;
+  plan->seg_cnt = 0;
 
   /* Read program headers. */
   file_ofs = ehdr.e_phoff;
   for (i = 0; i < ehdr.e_phnum; i++)
     {
       struct Elf32_Phdr phdr;
+      struct plan_segment *seg;
+      uint32_t page_offset;
 
       if (file_ofs < 0 || file_ofs > file_length (file))
-        goto done;
+        goto error;
       file_seek (file, file_ofs);
 
       if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-        goto done;
+        goto error;
       file_ofs += sizeof phdr;
       switch (phdr.p_type)
         {
@@ -443,57 +668,48 @@ load (const char *file_name, void (**eip) (void), void **esp)
         case PT_DYNAMIC:
         case PT_INTERP:
         case PT_SHLIB:
-          goto done;
+          goto error;
         case PT_LOAD:
-          if (validate_segment (&phdr, file))
+          if (!validate_segment (&phdr, file))
+            goto error;
+          seg = &plan->segs[plan->seg_cnt++];
+          seg->writable = (phdr.p_flags & PF_W) != 0;
+          seg->file_page = phdr.p_offset & ~PGMASK;
+          seg->mem_page = phdr.p_vaddr & ~PGMASK;
+          page_offset = phdr.p_vaddr & PGMASK;
+          if (phdr.p_filesz > 0)
             {
-              bool writable = (phdr.p_flags & PF_W) != 0;
-              uint32_t file_page = phdr.p_offset & ~PGMASK;
-              uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
-              uint32_t page_offset = phdr.p_vaddr & PGMASK;
-              uint32_t read_bytes, zero_bytes;
-              if (phdr.p_filesz > 0)
-                {
-                  /* Normal segment.
-                     Read initial part from disk and zero the rest. */
-                  read_bytes = page_offset + phdr.p_filesz;
-                  zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-                                - read_bytes);
-                }
-              else
-                {
-                  /* Entirely zero.
-                     Don't read anything from disk. */
-                  read_bytes = 0;
-                  zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
-                }
-              if (!load_segment (file, file_page, (void *) mem_page,
-                                 read_bytes, zero_bytes, writable))
-                goto done;
+              /* Normal segment.
+                 Read initial part from disk and zero the rest. */
+              seg->read_bytes = page_offset + phdr.p_filesz;
+              seg->zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
+                                 - seg->read_bytes);
             }
           else
-            goto done;
+            {
+              /* Entirely zero.
+                 Don't read anything from disk. */
+              seg->read_bytes = 0;
+              seg->zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
+            }
           break;
         }
     }
 
-  /* Set up stack. */
-  if (!setup_stack (esp))
-    goto done;
-
-  /* Start address. */
-  *eip = (void (*) (void)) ehdr.e_entry;
+  /* An executable must load something, if only because its heap
+     starts just past what it loads. */
+  if (plan->seg_cnt == 0)
+    goto error;
+  return plan;
 
-  success = true;
-
- done:
-  /* We arrive here whether the load is successful or not. */
-  return success;
+ error:
+  free (plan);
+  return NULL;
 }
-
-/* load() helpers. */
 
+#ifndef VM
 static bool inststack_size_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -552,6 +768,9 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With virtual memory, the pages are only recorded in the
+   supplemental page table here, and read in when first touched.
+
    Return true if successful, false if a memory stack_sizeocation error
    or disk read error occurs. */
 static bool
@@ -562,7 +781,9 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifndef VM
   file_seek (file, ofs);
+#endif
   while (read_bytes > 0 || zero_bytes > 0)
     {
       /* Calculate how to fill this page.
@@ -571,6 +792,12 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      /* Record where the page comes from. */
+      if (!page_add_file (upage, file, ofs, page_read_bytes, writable))
+        return false;
+      ofs += page_read_bytes;
+#else
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -590,6 +817,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false;
         }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -600,10 +828,19 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+   user virtual memory.  With virtual memory, the page stays
+   pinned until the end of load(), which reads the program's
+   file name from it. */
 static bool
 setup_stack (void **esp)
 {
+#ifdef VM
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+  bool success = page_add_zero (upage, true) && page_pin (upage);
+  if (success)
+    *esp = PHYS_BASE - 16;
+  return success;
+#else
   uint8_t *kpage;
   bool success = false;
 
@@ -617,8 +854,81 @@ setup_stack (void **esp)
         palloc_free_page (kpage);
     }
   return success;
+#endif
+}
+
+/* Copies the LEN bytes of arguments in ARGS, as described by
+   `struct exec_info', onto the stack page of the current
+   process, below *ESP, as the arguments to main(), and points
+   *ESP at the fake return address below them.
+
+   ARGS is copied, and a command line split into words, in a
+   single pass, with a pointer to each argument pushed below the
+   copy as the argument is found.  That leaves argv[] backward,
+   so it is reversed and slid down to where the stack alignment
+   wants it at the end.  Returns argv[0], or a null pointer if
+   there are no arguments or they do not fit in the stack
+   page. */
+static char *
+push_args (const char *args, size_t len, bool packed, void **esp)
+{
+  /* Room left below argv[] for argv[argc], alignment padding,
+     argv, argc, and the return address. */
+  const size_t reserve = 48;
+  uint8_t *bottom = (uint8_t *) PHYS_BASE - PGSIZE;
+  char *dst, **top, **slot, **argv;
+  size_t argc, i;
+
+  ASSERT (len > 0 && args[len - 1] == '\0');
+  if (len > (size_t) ((uint8_t *) *esp - bottom) - reserve)
+    return NULL;
+
+  /* Copy ARGS, splitting a command line, and push the argument
+     pointers.  Each string in packed ARGS is an argument, even
+     if empty; a command line's words are separated by spaces. */
+  dst = (char *) *esp - len;
+  top = slot = (char **) ROUND_DOWN ((uintptr_t) dst, sizeof *slot);
+  for (i = 0; i < len; i++)
+    {
+      char c = args[i];
+
+      if (!packed && c == ' ')
+        c = '\0';
+      else if (packed
+               ? i == 0 || args[i - 1] == '\0'
+               : c != '\0' && (i == 0 || args[i - 1] == ' '))
+        {
+          if ((uint8_t *) (slot - 1) < bottom + reserve)
+            return NULL;
+          *--slot = dst + i;
+        }
+      dst[i] = c;
+    }
+  argc = top - slot;
+  if (argc == 0)
+    return NULL;
+
+  /* Put argv[] in order, then move it down so that the stack
+     pointer ends up 4 bytes below a 16-byte boundary, as on
+     entry to any function. */
+  for (i = 0; i < argc / 2; i++)
+    {
+      char *tmp = slot[i];
+      slot[i] = slot[argc - 1 - i];
+      slot[argc - 1 - i] = tmp;
+    }
+  argv = (char **) (ROUND_DOWN ((uintptr_t) (slot - 4), 16) + 8);
+  memmove (argv, slot, argc * sizeof *argv);
+  argv[argc] = NULL;
+
+  argv[-1] = (char *) argv;
+  ((int *) argv)[-2] = argc;
+  argv[-3] = NULL;
+  *esp = argv - 3;
+  return argv[0];
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -638,3 +948,4 @@ inststack_size_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
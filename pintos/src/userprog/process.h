@@ -1,10 +1,23 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include <stddef.h>
 #include "threads/thread.h"
 
-tid_t process_execute (const char *file_name);
+struct FILE;
+
+/* A file for process_spawn() to give the new process. */
+struct spawn_file
+  {
+    int fd;                     /* Descriptor in the new process. */
+    struct FILE *file;          /* File open under FD. */
+  };
+
+tid_t process_execute (const char *cmd_line);
+tid_t process_spawn (char *args, size_t args_len,
+                     const struct spawn_file *, size_t file_cnt);
 int process_wait (tid_t);
+tid_t process_wait_any (int *exit_code);
 void process_exit (void);
 void process_activate (void);
 
@@ -1,24 +1,35 @@
 #include "userprog/syscall.h"
+#include <console.h>
 #include <stdio.h>
 #include <syscall-nr.h>
+#include <string.h>
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
-#include "userprog/pagedir.h"
+#include "devices/input.h"
 #include "devices/shutdown.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
 #include "filesys/buffer-cache.h"
 #include "userprog/process.h"
+#include "userprog/uaccess.h"
+#ifdef VM
+#include "vm/brk.h"
+#include "vm/page.h"
+#endif
 #include <stdbool.h>
 
 #define READDIR_MAX_LEN 14
 
 static void syscall_handler (struct intr_frame *);
-static bool verify_addr (const void *, size_t);
-static bool verify_tid (tid_t);
+static bool verify_buffer (const void *, size_t, bool writable);
 static bool verify_fd (int);
-static bool verify_str (const char *);
+static struct FILE *lookup_file (int);
+static void console_write (const void *, size_t);
+static void console_flush_line (void);
+static char *copy_in_string (const char *);
 
 struct lock fs_lock;
 
@@ -31,62 +42,118 @@ syscall_init (void)
 
 /* helper functions to verify variables */
 
+/* Checks that the LEN bytes at user address P may be read, and
+   written too if WRITABLE, by touching a byte in each page.  The
+   file system and console read and write such a buffer in place,
+   with locks held, so it must be checked in advance rather than
+   faulting part way through. */
 static bool
-verify_addr (const void *p, size_t len)
+verify_buffer (const void *p, size_t len, bool writable)
 {
+  const uint8_t *upage;
+
   ASSERT (len > 0);
-  struct thread *t = thread_current();
-  if (p == NULL)
-    return false;
-  else if (!is_user_vaddr (p) || !is_user_vaddr (p + len - 1))
+  if (p == NULL || !is_user_vaddr (p)
+      || len > (uintptr_t) PHYS_BASE - (uintptr_t) p)
     return false;
-  else if (pagedir_get_page (t->pagedir, p) == NULL
-          || pagedir_get_page (t->pagedir, p + len - 1) == NULL)
-    return false;
-  else
-    return true;
+  for (upage = pg_round_down (p); upage <= (const uint8_t *) p + len - 1;
+       upage += PGSIZE)
+    {
+      uint8_t *addr = (uint8_t *) (upage < (const uint8_t *) p ? p : upage);
+#ifdef VM
+      /* Pinned until the system call returns, so that it cannot
+         be evicted before we use it.  A buffer on the stack may
+         lie in pages the stack has not grown into yet. */
+      if (!page_pin (upage)
+          && !(page_grow_stack (addr, thread_current ()->user_esp)
+               && page_pin (upage)))
+        return false;
+#endif
+      if (writable ? !probe_user_write (addr) : !probe_user_read (addr))
+        return false;
+    }
+  return true;
 }
 
 static bool
 verify_fd (int fd)
 {
-  return (fd == 0) || (fd == 1) || ((fd > 1) && (fd < MAX_OPEN_FILES) 
-          && (thread_current ()->open_files[fd] != NULL));
+  return (fd == 0) || (fd == 1) || lookup_file (fd) != NULL;
 }
 
-static bool
-verify_str (const char *str)
+/* Returns the file open as FD in the current process, or a null
+   pointer if FD is not open or is a console descriptor. */
+static struct FILE *
+lookup_file (int fd)
 {
-  const int MAX_LEN = 128;
-  int len = 0;
-  if (str == NULL)
-    return false;
-  do {
-    if(!verify_addr(str, sizeof(char)))
-      return false;
-  } while (*(str++)!='\0' && (++len) < MAX_LEN);
-  return true;
+  return fd_table_get (&thread_current ()->fds, fd);
 }
 
-static bool
-verify_tid (tid_t tid) 
-{
-  struct list_elem *e;
-  struct thread *cur = thread_current();
-  for (e = list_begin (&cur->children); e != list_end (&cur->children); e = list_next (e)) {
-    struct wait_status *ws = list_entry (e, struct wait_status, elem);
-    if (ws->tid == tid) {
-      return true;
+/* Writes the N bytes in BUFFER to the console for the current
+   process, a line at a time, so that lines written by different
+   processes do not mix.  Writes BUFFER out as it is if there is
+   no memory to hold back a line in. */
+static void
+console_write (const void *buffer, size_t n)
+{
+  struct thread *t = thread_current ();
+
+  if (t->console_line == NULL)
+    {
+      t->console_line = malloc (sizeof *t->console_line);
+      if (t->console_line == NULL)
+        {
+          putbuf (buffer, n);
+          return;
+        }
+      t->console_line->len = 0;
+    }
+  putbuf_line (t->console_line, buffer, n);
+}
+
+/* Writes out the incomplete line of console output the current
+   process has held back, if any, before it reads from the
+   keyboard or exits. */
+static void
+console_flush_line (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->console_line != NULL)
+    console_line_flush (t->console_line);
+}
+
+/* Copies the string at user address USTR into a new page and
+   returns it.  Returns a null pointer if USTR is not a readable
+   string shorter than a page or if memory is exhausted.  The
+   caller must free the page with palloc_free_page(). */
+static char *
+copy_in_string (const char *ustr)
+{
+  char *kstr = palloc_get_page (0);
+  int len;
+
+  if (kstr != NULL
+      && ((len = strncpy_from_user (kstr, ustr, PGSIZE)) < 0
+          || len == PGSIZE))
+    {
+      palloc_free_page (kstr);
+      kstr = NULL;
     }
-  } 
-  return false;
+  return kstr;
 }
 
 static void
 syscall_handler (struct intr_frame *f)
 {
-  bool bad_args = false;
-  uint32_t* args = ((uint32_t*) f->esp);
+  uint32_t args[5];             /* Syscall number and arguments. */
+  size_t arg_cnt = 0;
+
+#ifdef VM
+  /* Page faults taken in the kernel on behalf of the process need
+     the user stack pointer to decide whether to grow the stack. */
+  thread_current ()->user_esp = f->esp;
+#endif
 
   /*
    * The following print statement, if uncommented, will print out the syscall
@@ -97,18 +164,19 @@ syscall_handler (struct intr_frame *f)
 
   //printf("System call number: %d\n", args[0]);
 
-  /* verify syscall number */
-  if (!verify_addr(args, sizeof(uint32_t*))) {
+  /* copy in syscall number */
+  if (!copy_from_user (args, f->esp, sizeof *args)) {
     syscall_exit (-1);
   }
 
-  /* verify arguments addr*/
+  /* count arguments */
   switch (args[0])
     {
     case SYS_HALT:
     case SYS_CACHE_FLUSH:
     case SYS_BWCNT:
     case SYS_BRCNT:
+    case SYS_SCHED_DUMP:
       /* have no argument */
       break;
     case SYS_PRACTICE:
@@ -124,27 +192,46 @@ syscall_handler (struct intr_frame *f)
     case SYS_MKDIR:
     case SYS_ISDIR:
     case SYS_INUMBER:
+    case SYS_WAIT_ANY:
+#ifdef VM
+    case SYS_MUNMAP:
+    case SYS_SBRK:
+#endif
       /* these cases have one argument */
-      bad_args = !verify_addr (args + 4, sizeof(uint32_t*));
+      arg_cnt = 1;
       break;
     case SYS_CREATE:
     case SYS_SEEK:
     case SYS_READDIR:
+    case SYS_ENTER:
+#ifdef VM
+    case SYS_MMAP:
+#endif
       /* these cases have two arguments */
-      bad_args = !verify_addr (args + 4, 2*sizeof(uint32_t*));
+      arg_cnt = 2;
       break;
     case SYS_READ:
     case SYS_WRITE:
+    case SYS_READV:
+    case SYS_WRITEV:
     case SYS_CACHE_STAT:
+    case SYS_SPAWN:
       /* these cases have three arguments */
-      bad_args = !verify_addr (args + 4, 3*sizeof(uint32_t*));
+      arg_cnt = 3;
+      break;
+    case SYS_PREAD:
+    case SYS_PWRITE:
+      /* these cases have four arguments */
+      arg_cnt = 4;
       break;
     default:
       /* Incorrect syscall number */
-      bad_args = true;
+      syscall_exit (-1);
     }
 
-  if (bad_args)
+  /* copy in arguments */
+  if (!copy_from_user (args + 1, (uint32_t *) f->esp + 1,
+                       arg_cnt * sizeof *args))
     {
       syscall_exit(-1);
     }
@@ -209,6 +296,39 @@ syscall_handler (struct intr_frame *f)
     case SYS_INUMBER:
       f->eax = syscall_inumber (args[1]);
       break;
+    case SYS_READV:
+      f->eax = syscall_readv (args[1], (struct iovec *)args[2], args[3]);
+      break;
+    case SYS_WRITEV:
+      f->eax = syscall_writev (args[1], (struct iovec *)args[2], args[3]);
+      break;
+    case SYS_PREAD:
+      f->eax = syscall_pread (args[1], (void *)args[2], args[3], args[4]);
+      break;
+    case SYS_PWRITE:
+      f->eax = syscall_pwrite (args[1], (void *)args[2], args[3], args[4]);
+      break;
+    case SYS_ENTER:
+      f->eax = syscall_enter ((struct io_ring *)args[1], args[2]);
+      break;
+    case SYS_SPAWN:
+      f->eax = syscall_spawn ((const char *const *)args[1],
+                              (struct spawn_action *)args[2], args[3]);
+      break;
+    case SYS_WAIT_ANY:
+      f->eax = syscall_wait_any ((int *)args[1]);
+      break;
+#ifdef VM
+    case SYS_MMAP:
+      f->eax = syscall_mmap (args[1], (void *)args[2]);
+      break;
+    case SYS_MUNMAP:
+      syscall_munmap (args[1]);
+      break;
+    case SYS_SBRK:
+      f->eax = (uint32_t) syscall_sbrk (args[1]);
+      break;
+#endif
     case SYS_CACHE_FLUSH:
       syscall_cache_flush ();
       break;
@@ -221,9 +341,15 @@ syscall_handler (struct intr_frame *f)
     case SYS_BWCNT:
       f->eax = syscall_bwcnt ();
       break;
+    case SYS_SCHED_DUMP:
+      syscall_sched_dump ();
+      break;
     default:
       ASSERT (false);
     }
+#ifdef VM
+  page_unpin_all ();
+#endif
 }
 
 /* process control syscalls */
@@ -244,6 +370,7 @@ void
 syscall_exit (int status)
 {
   struct thread *t = thread_current();
+  console_flush_line ();
   printf ("%s: exit(%d)\n", t->name, status);
   t->wait_status->exit_code = status;
   thread_exit();
@@ -253,12 +380,91 @@ tid_t
 syscall_exec (const char* cmd_line)
 {
   tid_t tid = -1;
-  if (!verify_str(cmd_line))
+  char *kcmd_line = copy_in_string (cmd_line);
+  if (kcmd_line == NULL)
     syscall_exit(-1);
-  tid = process_execute (cmd_line);
+  tid = process_execute (kcmd_line);
+  palloc_free_page (kcmd_line);
   return tid;
 }
 
+/* Starts a process running argv[0] with the null-terminated
+   argument list ARGV, giving it the files named by the
+   ACTION_CNT ACTIONS.  Unlike exec, does not wait for the load:
+   if it fails, the new process exits with status -1, which
+   wait() reports. */
+tid_t
+syscall_spawn (const char *const argv[], const struct spawn_action *actions,
+               size_t action_cnt)
+{
+  struct spawn_action kactions[SPAWN_ACTIONS_MAX];
+  struct spawn_file files[SPAWN_ACTIONS_MAX];
+  char *args;
+  size_t len = 0;
+  size_t i;
+
+  if (action_cnt > SPAWN_ACTIONS_MAX
+      || (action_cnt > 0
+          && !copy_from_user (kactions, actions,
+                              action_cnt * sizeof *kactions)))
+    syscall_exit (-1);
+  for (i = 0; i < action_cnt; i++)
+    if (lookup_file (kactions[i].parent_fd) == NULL)
+      syscall_exit (-1);
+
+  /* Pack the arguments into a page, one after another. */
+  args = palloc_get_page (0);
+  if (args == NULL)
+    return TID_ERROR;
+  for (i = 0; ; i++)
+    {
+      const char *arg;
+      int arg_len;
+
+      if (!copy_from_user (&arg, argv + i, sizeof arg))
+        {
+          palloc_free_page (args);
+          syscall_exit (-1);
+        }
+      if (arg == NULL)
+        break;
+      arg_len = strncpy_from_user (args + len, arg, PGSIZE - len);
+      if (arg_len < 0)
+        {
+          palloc_free_page (args);
+          syscall_exit (-1);
+        }
+      if ((size_t) arg_len == PGSIZE - len)
+        {
+          /* The arguments do not fit in a page. */
+          palloc_free_page (args);
+          return TID_ERROR;
+        }
+      len += arg_len + 1;
+    }
+  if (len == 0)
+    {
+      palloc_free_page (args);
+      return TID_ERROR;
+    }
+
+  /* Open the files again for the new process. */
+  for (i = 0; i < action_cnt; i++)
+    {
+      files[i].fd = kactions[i].child_fd;
+      files[i].file = filesys_reopen (lookup_file (kactions[i].parent_fd));
+      if (files[i].file == NULL)
+        {
+          while (i-- > 0)
+            filesys_close (files[i].file);
+          palloc_free_page (args);
+          return TID_ERROR;
+        }
+    }
+
+  return process_spawn (args, len, files, action_cnt);
+}
+
 int
 syscall_wait (tid_t tid)
 {
@@ -267,15 +473,32 @@ syscall_wait (tid_t tid)
   return exit_code;
 }
 
+/* Waits for any child to die, stores its exit status into
+   *STATUS unless STATUS is null, and returns its pid.  Returns -1
+   if there is no child to wait for. */
+tid_t
+syscall_wait_any (int *status)
+{
+  int exit_code;
+  tid_t tid = process_wait_any (&exit_code);
+
+  if (tid != TID_ERROR && status != NULL
+      && !copy_to_user (status, &exit_code, sizeof exit_code))
+    syscall_exit (-1);
+  return tid;
+}
+
 /* file operations syscalls */
 
 bool
 syscall_create (const char *file, unsigned initial_size)
 {
   bool result = false;
-  if(!verify_str(file))
+  char *kfile = copy_in_string (file);
+  if (kfile == NULL)
     syscall_exit(-1);
-  result = filesys_create (file, initial_size);
+  result = filesys_create (kfile, initial_size);
+  palloc_free_page (kfile);
   return result;
 }
 
@@ -283,9 +506,11 @@ bool
 syscall_remove (const char *file)
 {
   bool result = false;
-  if(!verify_str(file))
+  char *kfile = copy_in_string (file);
+  if (kfile == NULL)
     syscall_exit(-1);
-  result = filesys_remove (file);
+  result = filesys_remove (kfile);
+  palloc_free_page (kfile);
   return result;
 }
 
@@ -293,22 +518,19 @@ int
 syscall_open (const char *file)
 {
   struct FILE *f;
-  int fd = 2;
-  if(!verify_str(file))
+  int fd;
+  char *kfile = copy_in_string (file);
+  if (kfile == NULL)
     syscall_exit(-1);
-  f = filesys_open (file);
-  
+  f = filesys_open (kfile);
+  palloc_free_page (kfile);
+
   if (f == NULL)
     return -1;
-  while (fd < MAX_OPEN_FILES && thread_current ()->open_files[fd] != NULL)
-    ++fd;
-  if (fd < MAX_OPEN_FILES)
-    thread_current ()->open_files[fd] = f;
-  else {
+  fd = fd_table_add (&thread_current ()->fds, f);
+  if (fd < 0)
     filesys_close(f);
-    fd = -1;
-  }
-    
+
   return fd;
 }
 
@@ -316,10 +538,9 @@ int
 syscall_filesize (int fd)
 {
   int result = -1;
-  struct FILE *f;
-  if (!verify_fd (fd) || fd == 0 || fd == 1)
+  struct FILE *f = lookup_file (fd);
+  if (f == NULL)
     syscall_exit (-1);
-  f = thread_current ()->open_files[fd];
   result = filesys_length (f);
   return result;
 }
@@ -328,16 +549,16 @@ int
 syscall_read (int fd, void* buffer, unsigned size)
 {
   int read_len = -1;
-  struct thread *t = thread_current ();
   if (size == 0)
     return 0;
-  if (!verify_addr (buffer, size) || !verify_fd (fd)) 
+  if (!verify_buffer (buffer, size, true) || !verify_fd (fd))
     syscall_exit (-1);
   switch (fd)
     {
       case 0:
         // Read from stdin
         read_len = 0;
+        console_flush_line ();
         while (read_len < size){
           ((char*)buffer)[read_len++] = (char)input_getc();
         }
@@ -346,8 +567,7 @@ syscall_read (int fd, void* buffer, unsigned size)
         // Nothing happens if read from stdout
         break;
       default:
-        ASSERT(t->open_files != NULL);
-        struct FILE *f = t->open_files[fd];
+        struct FILE *f = lookup_file (fd);
         if (filesys_isdir(f)) {
           return 0;
         }
@@ -361,10 +581,9 @@ int
 syscall_write (int fd, const void* buffer, unsigned size) 
 {
   int write_len = -1;
-  struct thread *t = thread_current ();
   if (size == 0)
     return 0;
-  if (!verify_addr (buffer, size) || !verify_fd (fd)) 
+  if (!verify_buffer (buffer, size, false) || !verify_fd (fd))
     syscall_exit (-1);
   switch (fd)
     {
@@ -373,12 +592,11 @@ syscall_write (int fd, const void* buffer, unsigned size)
         break;
       case 1:
         // Write to stdout
-        putbuf (buffer, size);
+        console_write (buffer, size);
         write_len = size;
         break;
       default:
-        ASSERT (t->open_files != NULL);
-        struct FILE *f = t->open_files[fd];
+        struct FILE *f = lookup_file (fd);
         if (filesys_isdir (f)) {
           return -1;
         }
@@ -391,21 +609,19 @@ syscall_write (int fd, const void* buffer, unsigned size)
 void
 syscall_seek (int fd, unsigned position)
 {
-  struct file *f;
-  if (!verify_fd (fd) || fd == 0 || fd == 1)
+  struct FILE *f = lookup_file (fd);
+  if (f == NULL)
     return;
-  f = thread_current ()->open_files[fd]->ptr.file;
-  file_seek (f, position);
+  file_seek (f->ptr.file, position);
 }
 
 unsigned
 syscall_tell (int fd)
 {
-  struct FILE *f;
+  struct FILE *f = lookup_file (fd);
   unsigned offset;
-  if (!verify_fd (fd) || fd == 0 || fd == 1)
+  if (f == NULL)
     syscall_exit (-1);
-  f = thread_current ()->open_files[fd];
   offset = filesys_tell (f);
   return offset;
 }
@@ -413,59 +629,298 @@ syscall_tell (int fd)
 void
 syscall_close (int fd)
 {
-  struct FILE *f;
-  if (!verify_fd (fd) || fd == 0 || fd == 1)
+  struct FILE *f = fd_table_remove (&thread_current ()->fds, fd);
+  if (f == NULL)
     return;
-  f = thread_current ()->open_files[fd];
   filesys_close (f);
-  thread_current ()->open_files[fd] = NULL;
 }
 
 bool
 syscall_mkdir (const char *dir)
 {
-  if (!verify_str (dir))
+  bool result;
+  char *kdir = copy_in_string (dir);
+  if (kdir == NULL)
     return false;
-  return filesys_mkdir(dir);
+  result = filesys_mkdir(kdir);
+  palloc_free_page (kdir);
+  return result;
 }
 
 bool
 syscall_chdir (const char *dir)
 {
-  if (!verify_str (dir))
+  bool result;
+  char *kdir = copy_in_string (dir);
+  if (kdir == NULL)
     return false;
-  return filesys_chdir(dir);
+  result = filesys_chdir(kdir);
+  palloc_free_page (kdir);
+  return result;
 }
 
 bool
 syscall_readdir (int fd, char *name)
 {
-  if (!verify_fd (fd) || fd == 0 || fd == 1)
-    syscall_exit (-1);
-  if (!verify_addr (name, READDIR_MAX_LEN + 1))
+  char kname[READDIR_MAX_LEN + 1];
+  struct FILE *f = lookup_file (fd);
+  if (f == NULL || !filesys_isdir (f))
     syscall_exit (-1);
-  if (!syscall_isdir (fd))
+
+  if (!filesys_readdir (f, kname))
+    return false;
+  if (!copy_to_user (name, kname, strlen (kname) + 1))
     syscall_exit (-1);
-  
-  return filesys_readdir (thread_current ()->open_files[fd], name);
+  return true;
 }
 
 bool
 syscall_isdir (int fd)
 {
-  if (!verify_fd (fd) || fd == 0 || fd == 1)
+  struct FILE *f = lookup_file (fd);
+  if (f == NULL)
     syscall_exit (-1);
-  return filesys_isdir (thread_current ()->open_files[fd]);
+  return filesys_isdir (f);
 }
 
 int
 syscall_inumber (int fd)
 {
-  if (!verify_fd (fd) || fd == 0 || fd == 1)
+  struct FILE *f = lookup_file (fd);
+  if (f == NULL)
+    syscall_exit (-1);
+
+  return filesys_inumber (f);
+}
+
+/* vectored and positioned I/O syscalls */
+
+/* Reads (if WRITE is false) or writes the buffers described by
+   the IOVCNT entries of the user array IOV from or to FD, in
+   order, stopping early at a short transfer.  A file is read or
+   written at its current position, which is advanced once, past
+   all of the bytes transferred.  Returns the number of bytes
+   transferred, or -1 on error. */
+static int
+transfer_vector (int fd, const struct iovec *iov, int iovcnt, bool write)
+{
+  struct FILE *f;
+  struct file *file = NULL;
+  off_t pos = 0;
+  int total = 0;
+  int i;
+
+  if (!verify_fd (fd))
+    syscall_exit (-1);
+  if (iovcnt < 0 || iovcnt > IOV_MAX || fd == (write ? 0 : 1))
+    return -1;
+  f = lookup_file (fd);
+  if (f != NULL)
+    {
+      if (filesys_isdir (f))
+        return -1;
+      file = f->ptr.file;
+      pos = file_tell (file);
+    }
+
+  for (i = 0; i < iovcnt; i++)
+    {
+      struct iovec v;
+      int n;
+
+      if (!copy_from_user (&v, iov + i, sizeof v))
+        syscall_exit (-1);
+      if (v.iov_len == 0)
+        continue;
+      if (v.iov_len > (size_t) (INT32_MAX - total))
+        break;
+      if (!verify_buffer (v.iov_base, v.iov_len, !write))
+        syscall_exit (-1);
+
+      if (file != NULL)
+        n = (write
+             ? file_write_at (file, v.iov_base, v.iov_len, pos)
+             : file_read_at (file, v.iov_base, v.iov_len, pos));
+      else if (write)
+        {
+          console_write (v.iov_base, v.iov_len);
+          n = v.iov_len;
+        }
+      else
+        {
+          uint8_t *buffer = v.iov_base;
+          console_flush_line ();
+          for (n = 0; (size_t) n < v.iov_len; n++)
+            buffer[n] = input_getc ();
+        }
+#ifdef VM
+      /* Let go of this buffer's pages before pinning the next
+         buffer's, so that the pages pinned at once are bounded
+         by one buffer, not all of them. */
+      page_unpin_all ();
+#endif
+
+      pos += n;
+      total += n;
+      if ((size_t) n < v.iov_len)
+        break;
+    }
+
+  if (file != NULL)
+    file_seek (file, pos);
+  return total;
+}
+
+int
+syscall_readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  return transfer_vector (fd, iov, iovcnt, false);
+}
+
+int
+syscall_writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  return transfer_vector (fd, iov, iovcnt, true);
+}
+
+int
+syscall_pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  struct FILE *f;
+  if (!verify_fd (fd))
+    syscall_exit (-1);
+  if (size == 0)
+    return 0;
+  if (!verify_buffer (buffer, size, true))
+    syscall_exit (-1);
+  f = lookup_file (fd);
+  if (f == NULL || filesys_isdir (f) || offset > INT32_MAX
+      || size > INT32_MAX)
+    return -1;
+  return file_read_at (f->ptr.file, buffer, size, offset);
+}
+
+int
+syscall_pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  struct FILE *f;
+  if (!verify_fd (fd))
+    syscall_exit (-1);
+  if (size == 0)
+    return 0;
+  if (!verify_buffer (buffer, size, false))
+    syscall_exit (-1);
+  f = lookup_file (fd);
+  if (f == NULL || filesys_isdir (f) || offset > INT32_MAX
+      || size > INT32_MAX)
+    return -1;
+  return file_write_at (f->ptr.file, buffer, size, offset);
+}
+
+/* batched syscalls */
+
+/* Carries out submission entry SQE and returns its result. */
+static int
+ring_do_op (const struct io_sqe *sqe)
+{
+  switch (sqe->opcode)
+    {
+    case IO_OP_NOP:
+      return 0;
+    case IO_OP_READ:
+      return syscall_read (sqe->fd, sqe->buf, sqe->len);
+    case IO_OP_WRITE:
+      return syscall_write (sqe->fd, sqe->buf, sqe->len);
+    case IO_OP_PREAD:
+      return syscall_pread (sqe->fd, sqe->buf, sqe->len, sqe->offset);
+    case IO_OP_PWRITE:
+      return syscall_pwrite (sqe->fd, sqe->buf, sqe->len, sqe->offset);
+    case IO_OP_OPEN:
+      return syscall_open (sqe->buf);
+    case IO_OP_CLOSE:
+      syscall_close (sqe->fd);
+      return 0;
+    default:
+      return -1;
+    }
+}
+
+/* Carries out up to TO_SUBMIT operations queued in user RING, in
+   order, posting a completion for each, and returns the number
+   carried out.  Stops early if the completion queue is full.
+   An operation that would kill the process as a system call,
+   such as a read into a bad buffer, does so here too. */
+int
+syscall_enter (struct io_ring *ring, unsigned to_submit)
+{
+  uint32_t idx[4];              /* SQ_HEAD, SQ_TAIL, CQ_HEAD, CQ_TAIL. */
+  uint32_t sq_head, cq_tail;
+  unsigned done;
+
+  if (!copy_from_user (idx, ring, sizeof idx))
+    syscall_exit (-1);
+  sq_head = idx[0];
+  cq_tail = idx[3];
+  if (idx[1] - sq_head > IO_RING_ENTRIES
+      || cq_tail - idx[2] > IO_RING_ENTRIES)
+    return -1;
+  if (to_submit > idx[1] - sq_head)
+    to_submit = idx[1] - sq_head;
+
+  for (done = 0; done < to_submit; done++)
+    {
+      struct io_sqe sqe;
+      struct io_cqe cqe;
+
+      if (cq_tail - idx[2] == IO_RING_ENTRIES)
+        break;
+      if (!copy_from_user (&sqe, &ring->sqes[sq_head % IO_RING_ENTRIES],
+                           sizeof sqe))
+        syscall_exit (-1);
+      cqe.user_data = sqe.user_data;
+      cqe.res = ring_do_op (&sqe);
+#ifdef VM
+      page_unpin_all ();
+#endif
+      if (!copy_to_user (&ring->cqes[cq_tail % IO_RING_ENTRIES], &cqe,
+                         sizeof cqe))
+        syscall_exit (-1);
+      sq_head++;
+      cq_tail++;
+    }
+
+  if (!copy_to_user (&ring->sq_head, &sq_head, sizeof sq_head)
+      || !copy_to_user (&ring->cq_tail, &cq_tail, sizeof cq_tail))
     syscall_exit (-1);
-  
-  return filesys_inumber (thread_current ()->open_files[fd]);
+  return done;
+}
+
+#ifdef VM
+/* memory-mapped files syscalls */
+
+mapid_t
+syscall_mmap (int fd, void *addr)
+{
+  struct FILE *f = lookup_file (fd);
+  if (f == NULL || filesys_isdir (f))
+    return MAP_FAILED;
+  return mmap_map (f->ptr.file, addr);
+}
+
+void
+syscall_munmap (mapid_t mapping)
+{
+  mmap_unmap (mapping);
+}
+
+/* heap syscalls */
+
+void *
+syscall_sbrk (intptr_t increment)
+{
+  return brk_move (increment);
 }
+#endif
 
 void
 syscall_cache_flush ()
@@ -476,11 +931,12 @@ syscall_cache_flush ()
 void
 syscall_cache_stat (int *hit_cnt, int *read_cnt, int *write_cnt)
 {
-  if (!verify_addr (hit_cnt, sizeof (uint32_t))
-      || !verify_addr (read_cnt, sizeof (uint32_t))
-      || !verify_addr (write_cnt, sizeof (uint32_t)))
+  uint32_t hits, reads, writes;
+  cache_stat (&hits, &reads, &writes);
+  if (!copy_to_user (hit_cnt, &hits, sizeof hits)
+      || !copy_to_user (read_cnt, &reads, sizeof reads)
+      || !copy_to_user (write_cnt, &writes, sizeof writes))
       syscall_exit (-1);
-  cache_stat (hit_cnt, read_cnt, write_cnt);
 }
 
 unsigned long long
@@ -494,3 +950,11 @@ syscall_bwcnt ()
 {
   return block_write_cnt (fs_device);
 }
+
+/* scheduler tracing syscall */
+
+void
+syscall_sched_dump ()
+{
+  sched_trace_dump ();
+}
@@ -2,6 +2,10 @@
 #define USERPROG_SYSCALL_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <io-ring.h>
+#include <syscall-types.h>
 typedef int tid_t;
 
 void syscall_init (void);
@@ -30,6 +34,31 @@ bool syscall_readdir (int fd, char *name);
 bool syscall_isdir (int fd);
 int syscall_inumber (int fd);
 
+/* vectored and positioned I/O syscalls */
+int syscall_readv (int fd, const struct iovec *, int iovcnt);
+int syscall_writev (int fd, const struct iovec *, int iovcnt);
+int syscall_pread (int fd, void *, unsigned, unsigned offset);
+int syscall_pwrite (int fd, const void *, unsigned, unsigned offset);
+
+/* batched syscalls */
+int syscall_enter (struct io_ring *, unsigned to_submit);
+
+/* process creation syscalls */
+tid_t syscall_spawn (const char *const argv[], const struct spawn_action *,
+                     size_t action_cnt);
+tid_t syscall_wait_any (int *status);
+
+#ifdef VM
+#include "vm/mmap.h"
+
+/* memory-mapped files. */
+mapid_t syscall_mmap (int fd, void *addr);
+void syscall_munmap (mapid_t);
+
+/* heap syscalls. */
+void *syscall_sbrk (intptr_t increment);
+#endif
+
 /* buffer cache backend. */
 void syscall_cache_flush (void);
 void syscall_cache_stat (int *, int *, int *);
@@ -37,4 +66,7 @@ void syscall_cache_stat (int *, int *, int *);
 unsigned long long syscall_bwcnt (void);
 unsigned long long syscall_brcnt (void);
 
+/* scheduler tracing. */
+void syscall_sched_dump (void);
+
 #endif /* userprog/syscall.h */
@@ -0,0 +1,178 @@
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/vaddr.h"
+
+/* Access to user memory from the kernel.
+
+   Rather than checking that user memory is mapped before
+   touching it, which costs a page table walk per page, the
+   functions here just touch it.  If that faults, because the
+   address is unmapped or is written but read-only, the page
+   fault handler calls uaccess_fixup(), which looks up the
+   faulting instruction in the exception table, a list of the
+   instructions here that may touch user memory, each paired
+   with the address of code to resume at.  The handler resumes
+   there with EAX set to -1, and the function reports failure.
+   With virtual memory, the page fault handler first tries to
+   bring the page in, in which case the faulting instruction is
+   simply restarted.
+
+   Each function first checks that the memory it is asked to
+   access lies entirely below PHYS_BASE, since kernel memory
+   would not fault. */
+
+/* An exception table entry. */
+struct ex_entry
+  {
+    uintptr_t insn;             /* Instruction that may fault. */
+    uintptr_t fixup;            /* Where to resume if it does. */
+  };
+
+/* The exception table, gathered by the linker from the
+   __ex_table sections.  See kernel.lds.S. */
+extern const struct ex_entry _start_ex_table[], _end_ex_table[];
+
+/* Adds an exception table entry for the instruction at label
+   INSN, resuming at label FIXUP. */
+#define EX_TABLE(INSN, FIXUP)                           \
+        ".pushsection __ex_table, \"a\"\n"              \
+        ".long " #INSN ", " #FIXUP "\n"                 \
+        ".popsection\n"
+
+/* Returns true if the SIZE bytes at UADDR all lie in user
+   virtual memory. */
+static bool
+user_range_ok (const void *uaddr, size_t size)
+{
+  uintptr_t start = (uintptr_t) uaddr;
+  return start <= (uintptr_t) PHYS_BASE
+         && size <= (uintptr_t) PHYS_BASE - start;
+}
+
+/* Copies SIZE bytes from DST to SRC, either of which may be in
+   user memory, and returns the number of bytes not copied, which
+   is nonzero only if an access faulted. */
+static size_t
+copy_raw (void *dst, const void *src, size_t size)
+{
+  asm volatile ("1: rep movsb\n"
+                "2:\n"
+                EX_TABLE (1b, 2b)
+                : "+D" (dst), "+S" (src), "+c" (size)
+                : : "eax", "memory");
+  return (int) size;
+}
+
+/* Reads and returns the byte at user address UADDR, or returns
+   -1 if the read faults.  UADDR must be below PHYS_BASE. */
+static inline int
+get_user (const uint8_t *uaddr)
+{
+  int result;
+  asm volatile ("1: movzbl %1, %0\n"
+                "2:\n"
+                EX_TABLE (1b, 2b)
+                : "=&a" (result) : "m" (*uaddr));
+  return result;
+}
+
+/* Writes BYTE to user address UDST.  Returns true if successful,
+   false if the write faults.  UDST must be below PHYS_BASE. */
+static inline bool
+put_user (uint8_t *udst, uint8_t byte)
+{
+  int error_code = 0;
+  asm volatile ("1: movb %b2, %0\n"
+                "2:\n"
+                EX_TABLE (1b, 2b)
+                : "=m" (*udst), "+a" (error_code) : "q" (byte));
+  return error_code != -1;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Returns true if successful, false if any of the source
+   bytes is not readable user memory. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  return user_range_ok (usrc, size) && copy_raw (dst, usrc, size) == 0;
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Returns true if successful, false if any of the
+   destination bytes is not writable user memory. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  return user_range_ok (udst, size) && copy_raw (udst, src, size) == 0;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   the SIZE bytes at DST.  Returns the length of the string, not
+   counting the null terminator, or -1 if the string is not in
+   readable user memory.  If the string is readable but does not
+   fit in SIZE bytes, returns SIZE, leaving DST unterminated. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  size_t i;
+
+  if ((uintptr_t) usrc >= (uintptr_t) PHYS_BASE)
+    return -1;
+  for (i = 0; i < size; i++)
+    {
+      int c;
+
+      /* A string that runs into kernel memory is not readable. */
+      if ((uintptr_t) (usrc + i) >= (uintptr_t) PHYS_BASE)
+        return -1;
+      c = get_user ((const uint8_t *) usrc + i);
+      if (c == -1)
+        return -1;
+      dst[i] = c;
+      if (c == '\0')
+        return i;
+    }
+  return size;
+}
+
+/* Returns true if the byte at user address UADDR is readable. */
+bool
+probe_user_read (const void *uaddr)
+{
+  return is_user_vaddr (uaddr) && get_user (uaddr) != -1;
+}
+
+/* Returns true if the byte at user address UADDR is writable.
+   The byte is read and written back unchanged. */
+bool
+probe_user_write (void *uaddr)
+{
+  int c;
+
+  if (!is_user_vaddr (uaddr))
+    return false;
+  c = get_user (uaddr);
+  return c != -1 && put_user (uaddr, c);
+}
+
+/* Called by the page fault handler for a fault taken in kernel
+   context.  If the faulting instruction is one of those in the
+   exception table, arranges for F to resume at its fixup address
+   with EAX set to -1 and returns true.  Otherwise returns
+   false. */
+bool
+uaccess_fixup (struct intr_frame *f)
+{
+  const struct ex_entry *e;
+
+  for (e = _start_ex_table; e < _end_ex_table; e++)
+    if (e->insn == (uintptr_t) f->eip)
+      {
+        f->eip = (void *) e->fixup;
+        f->eax = 0xffffffff;
+        return true;
+      }
+  return false;
+}
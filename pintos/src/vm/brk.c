@@ -0,0 +1,59 @@
+#include "vm/brk.h"
+#include <debug.h>
+#include <round.h>
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* Sets the current process's heap, initially empty, to start at
+   page-aligned user address START. */
+void
+brk_init (void *start)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (pg_ofs (start) == 0);
+
+  t->heap_start = t->brk = start;
+}
+
+/* Moves the current process's break INCREMENT bytes up, or down
+   if INCREMENT is negative, adding or removing heap pages as
+   needed, and returns the old break.  Returns (void *) -1 without
+   changing anything if the break would move below the start of
+   the heap or into the space reserved for the stack, or if
+   memory is exhausted. */
+void *
+brk_move (intptr_t increment)
+{
+  struct thread *t = thread_current ();
+  uintptr_t stack_bottom = (uintptr_t) PHYS_BASE - stack_page_limit * PGSIZE;
+  uintptr_t old_brk = (uintptr_t) t->brk;
+  uintptr_t new_brk = old_brk + increment;
+  uintptr_t old_end = ROUND_UP (old_brk, PGSIZE);
+  uintptr_t new_end, upage;
+
+  if (increment > 0
+      ? new_brk < old_brk || new_brk > stack_bottom
+      : new_brk > old_brk || new_brk < (uintptr_t) t->heap_start)
+    return (void *) -1;
+  new_end = ROUND_UP (new_brk, PGSIZE);
+
+  if (new_end > old_end)
+    for (upage = old_end; upage < new_end; upage += PGSIZE)
+      if (!page_reserve ((void *) upage))
+        {
+          /* Undo the pages added so far. */
+          while (upage > old_end)
+            {
+              upage -= PGSIZE;
+              page_remove ((void *) upage);
+            }
+          return (void *) -1;
+        }
+  for (upage = new_end; upage < old_end; upage += PGSIZE)
+    page_remove ((void *) upage);
+
+  t->brk = (void *) new_brk;
+  return (void *) old_brk;
+}
@@ -0,0 +1,17 @@
+#ifndef VM_BRK_H
+#define VM_BRK_H
+
+#include <stdint.h>
+
+/* Process heaps.
+
+   A process's heap starts at the first page above its
+   executable's segments and ends at its break, which sbrk()
+   moves.  Heap pages are zero pages that are added, with memory
+   reserved for them, as the break moves up, but are not read in
+   until touched, and are removed as it moves down. */
+
+void brk_init (void *start);
+void *brk_move (intptr_t increment);
+
+#endif /* vm/brk.h */
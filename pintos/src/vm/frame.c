@@ -0,0 +1,337 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+
+/* All frames holding pages, in clock order, and the frames
+   among them that may be shared.  Guarded by frame_lock, as are
+   the clock hand and every frame's list of pages. */
+static struct list frames;
+static struct hash shared_frames;
+static struct lock frame_lock;
+
+/* Next frame the clock sweep looks at, or null to start over
+   from the beginning. */
+static struct list_elem *hand;
+
+static hash_hash_func share_hash;
+static hash_less_func share_less;
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  if (!hash_init (&shared_frames, share_hash, share_less, NULL))
+    PANIC ("frame: shared frame table creation failed");
+  lock_init (&frame_lock);
+  hand = NULL;
+}
+
+/* Returns a hash value for shared frame F. */
+static unsigned
+share_hash (const struct hash_elem *f_, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (f_, struct frame, share_elem);
+  return hash_bytes (&f->inode, sizeof f->inode) ^ hash_int (f->ofs);
+}
+
+/* Returns true if shared frame A precedes shared frame B. */
+static bool
+share_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, share_elem);
+  const struct frame *b = hash_entry (b_, struct frame, share_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  else if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  else
+    return a->read_bytes < b->read_bytes;
+}
+
+/* Returns the frame under the clock hand and advances the hand.
+   The frame table must not be empty. */
+static struct frame *
+clock_next (void)
+{
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (!list_empty (&frames));
+
+  if (hand == NULL || hand == list_end (&frames))
+    hand = list_begin (&frames);
+  f = list_entry (hand, struct frame, elem);
+  hand = list_next (hand);
+  return f;
+}
+
+/* Removes F from the frame table, and from the shared frame
+   table if it is there, so that no page can be added to it. */
+static void
+frame_remove (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  if (hand == &f->elem)
+    hand = list_next (hand);
+  list_remove (&f->elem);
+  if (f->shared)
+    {
+      hash_delete (&shared_frames, &f->share_elem);
+      f->shared = false;
+    }
+}
+
+/* Releases the locks on the pages of F that precede STOP, or on
+   all of them if STOP is the end of the list. */
+static void
+unlock_pages (struct frame *f, struct list_elem *stop)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != stop; e = list_next (e))
+    lock_release (&list_entry (e, struct page, frame_elem)->lock);
+}
+
+/* Tries to lock every page mapping F.  Returns true if
+   successful, false if some page is locked already or is
+   pinned, in which case no page is left locked. */
+static bool
+try_lock_pages (struct frame *f)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      if (!lock_try_acquire (&p->lock))
+        {
+          unlock_pages (f, e);
+          return false;
+        }
+      if (p->pinned)
+        {
+          unlock_pages (f, list_next (e));
+          return false;
+        }
+    }
+  return true;
+}
+
+/* Returns true if any page mapping F has been accessed since the
+   last sweep, clearing the accessed bits of all of them. */
+static bool
+pages_accessed (struct frame *f)
+{
+  bool accessed = false;
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->owner->pagedir;
+
+      if (pagedir_is_accessed (pd, p->upage))
+        {
+          pagedir_set_accessed (pd, p->upage, false);
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Writes every page mapping F, all of which the caller has
+   locked, out of F.  Returns true if successful, false if the
+   page would need swap space and there is none.  Only a frame
+   with a single page can fail, since the pages of a shared
+   frame are read-only and never need swap space, so on failure
+   nothing has changed. */
+static bool
+pages_out (struct frame *f)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (!page_out (list_entry (e, struct page, frame_elem)))
+      {
+        ASSERT (e == list_begin (&f->pages));
+        return false;
+      }
+  return true;
+}
+
+/* Evicts the pages of some frame and returns the freed kernel
+   page, or a null pointer if no frame can be evicted.
+
+   Frames with a page that is pinned, or whose lock is held
+   (being paged in or out, or torn down), are passed over.
+   Otherwise a frame with a page whose accessed bit is set gets
+   a second chance: the bits are cleared and the sweep moves on.
+   Two full turns of the clock are enough to find a victim if
+   there is one. */
+static void *
+frame_evict (void)
+{
+  size_t tries;
+
+  lock_acquire (&frame_lock);
+  for (tries = 2 * list_size (&frames) + 1; tries > 0 && !list_empty (&frames);
+       tries--)
+    {
+      struct frame *f = clock_next ();
+      void *kpage;
+
+      if (!try_lock_pages (f))
+        continue;
+      if (pages_accessed (f))
+        {
+          unlock_pages (f, list_end (&f->pages));
+          continue;
+        }
+
+      /* Found a victim.  Its page locks keep its pages from being
+         paged in again until page_out() is done, and it is no
+         longer shared, so no page can be added to it. */
+      frame_remove (f);
+      lock_release (&frame_lock);
+      if (!pages_out (f))
+        {
+          /* Nowhere to put it.  Put it back and keep looking. */
+          lock_acquire (&frame_lock);
+          list_push_back (&frames, &f->elem);
+          unlock_pages (f, list_end (&f->pages));
+          continue;
+        }
+      kpage = f->kpage;
+      while (!list_empty (&f->pages))
+        lock_release (&list_entry (list_pop_front (&f->pages),
+                                   struct page, frame_elem)->lock);
+      free (f);
+      return kpage;
+    }
+  lock_release (&frame_lock);
+  return NULL;
+}
+
+/* Allocates a frame for PAGE, evicting pages from another frame
+   if the user pool is exhausted, and returns it.  If ZERO is
+   true, the frame is filled with zeros, preferably by taking a
+   page the idle thread has already zeroed.  Returns a null
+   pointer if no frame could be found.  The caller must hold
+   PAGE's lock, so that the new frame is not chosen for eviction
+   before PAGE has been read into it. */
+struct frame *
+frame_alloc (struct page *page, bool zero)
+{
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&page->lock));
+
+  f = malloc (sizeof *f);
+  if (f == NULL)
+    return NULL;
+  f->kpage = palloc_get_page (PAL_USER | (zero ? PAL_ZERO : 0));
+  if (f->kpage == NULL)
+    {
+      f->kpage = frame_evict ();
+      if (f->kpage == NULL)
+        {
+          free (f);
+          return NULL;
+        }
+      if (zero)
+        memset (f->kpage, 0, PGSIZE);
+    }
+  list_init (&f->pages);
+  list_push_back (&f->pages, &page->frame_elem);
+  f->shared = false;
+
+  lock_acquire (&frame_lock);
+  list_push_back (&frames, &f->elem);
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Looks for a shared frame that already holds the contents of
+   PAGE, a read-only page read from a file.  If there is one,
+   adds PAGE to it and returns it; otherwise, returns a null
+   pointer.  The caller must hold PAGE's lock. */
+struct frame *
+frame_share (struct page *page)
+{
+  struct frame key;
+  struct hash_elem *e;
+  struct frame *f = NULL;
+
+  ASSERT (lock_held_by_current_thread (&page->lock));
+  ASSERT (page->type == PAGE_FILE && !page->writable);
+
+  key.inode = file_get_inode (page->file);
+  key.ofs = page->ofs;
+  key.read_bytes = page->read_bytes;
+
+  lock_acquire (&frame_lock);
+  e = hash_find (&shared_frames, &key.share_elem);
+  if (e != NULL)
+    {
+      f = hash_entry (e, struct frame, share_elem);
+      list_push_back (&f->pages, &page->frame_elem);
+    }
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Makes F, which holds the contents of a single read-only page
+   read from a file, available to frame_share().  F is left
+   private if another frame with the same contents got there
+   first. */
+void
+frame_publish (struct frame *f)
+{
+  struct page *page = list_entry (list_front (&f->pages),
+                                  struct page, frame_elem);
+
+  ASSERT (page->type == PAGE_FILE && !page->writable);
+
+  f->inode = file_get_inode (page->file);
+  f->ofs = page->ofs;
+  f->read_bytes = page->read_bytes;
+
+  lock_acquire (&frame_lock);
+  f->shared = hash_insert (&shared_frames, &f->share_elem) == NULL;
+  lock_release (&frame_lock);
+}
+
+/* Removes PAGE from F, freeing F once no page maps it. */
+void
+frame_release (struct frame *f, struct page *page)
+{
+  bool last;
+
+  lock_acquire (&frame_lock);
+  list_remove (&page->frame_elem);
+  last = list_empty (&f->pages);
+  if (last)
+    frame_remove (f);
+  lock_release (&frame_lock);
+
+  if (last)
+    {
+      palloc_free_page (f->kpage);
+      free (f);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+struct page;
+
+/* Frame table.
+
+   Every frame from the user pool that holds a page of some
+   process has an entry here.  When the user pool runs dry, a
+   clock sweep over the table picks a frame whose pages have not
+   been accessed recently, and page_out() writes them back.
+
+   Read-only pages read from a file, such as the code of a
+   program, are shared: a frame holding such a page is entered
+   in a table of shared frames keyed by inode and offset, and
+   any other process loading the same part of the same file
+   maps the frame instead of reading its own copy.  A frame is
+   freed when the last page mapping it goes away. */
+
+/* A user frame. */
+struct frame
+  {
+    struct list_elem elem;      /* Element in frame table. */
+    void *kpage;                /* Kernel virtual address. */
+    struct list pages;          /* Pages mapping the frame. */
+
+    /* Shared frames only. */
+    bool shared;                /* In the shared frame table? */
+    struct hash_elem share_elem; /* Element in shared frame table. */
+    struct inode *inode;        /* File the contents came from. */
+    off_t ofs;                  /* Offset in INODE. */
+    uint32_t read_bytes;        /* Bytes read; the rest is zeroed. */
+  };
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *, bool zero);
+struct frame *frame_share (struct page *);
+void frame_publish (struct frame *);
+void frame_release (struct frame *, struct page *);
+
+#endif /* vm/frame.h */
@@ -0,0 +1,120 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* Removes the first PAGE_CNT pages of mapping M, writing back
+   those that were modified. */
+static void
+unmap_pages (struct mapping *m, size_t page_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    page_remove ((uint8_t *) m->base + i * PGSIZE);
+}
+
+/* Removes mapping M from the current process and frees it. */
+static void
+unmap (struct mapping *m)
+{
+  unmap_pages (m, m->page_cnt);
+  list_remove (&m->elem);
+  file_close (m->file);
+  free (m);
+}
+
+/* Maps FILE into the current process's address space starting
+   at page-aligned user address ADDR, and returns the new
+   mapping's identifier.  Nothing is read until the pages are
+   touched.  Returns MAP_FAILED if FILE is empty, if ADDR is null
+   or misaligned, if any page of the mapping would overlap pages
+   already in use or the space reserved for the stack to grow
+   into, or if memory is exhausted. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  uint8_t *stack_bottom = (uint8_t *) PHYS_BASE - stack_page_limit * PGSIZE;
+  struct mapping *m;
+  off_t length;
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0 || addr >= (void *) stack_bottom)
+    return MAP_FAILED;
+  length = file_length (file);
+  if (length == 0 || (size_t) length > (size_t) (stack_bottom - (uint8_t *) addr))
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+
+  /* Reopen the file, so that the mapping outlives the file
+     descriptor it was made from. */
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return MAP_FAILED;
+    }
+  m->base = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      uint8_t *upage = (uint8_t *) addr + i * PGSIZE;
+      off_t ofs = i * PGSIZE;
+      uint32_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (!page_add_mmap (upage, m->file, ofs, read_bytes))
+        {
+          unmap_pages (m, i);
+          file_close (m->file);
+          free (m);
+          return MAP_FAILED;
+        }
+    }
+
+  m->mapid = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->mapid;
+}
+
+/* Removes the current process's mapping MAPID, writing back any
+   modified pages.  Returns true if successful, false if there is
+   no such mapping. */
+bool
+mmap_unmap (mapid_t mapid)
+{
+  struct list *mappings = &thread_current ()->mappings;
+  struct list_elem *e;
+
+  for (e = list_begin (mappings); e != list_end (mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->mapid == mapid)
+        {
+          unmap (m);
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Removes all of the current process's mappings, writing back
+   any modified pages.  Must be called before the supplemental
+   page table is destroyed. */
+void
+mmap_unmap_all (void)
+{
+  struct list *mappings = &thread_current ()->mappings;
+
+  while (!list_empty (mappings))
+    unmap (list_entry (list_front (mappings), struct mapping, elem));
+}
@@ -0,0 +1,33 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <list.h>
+#include <stddef.h>
+
+/* Memory-mapped files.
+
+   A mapping covers consecutive pages of a process's address
+   space, one per page of the file.  Its pages are PAGE_MMAP
+   pages in the supplemental page table: they are read from the
+   file when first touched, and written back to it only if
+   modified, when evicted or when the mapping is removed. */
+
+/* Identifies a mapping within a process. */
+typedef int mapid_t;
+#define MAP_FAILED ((mapid_t) -1)
+
+/* A memory-mapped file. */
+struct mapping
+  {
+    struct list_elem elem;      /* Element in thread's `mappings'. */
+    mapid_t mapid;              /* Mapping identifier. */
+    struct file *file;          /* File mapped, privately reopened. */
+    void *base;                 /* First page. */
+    size_t page_cnt;            /* Number of pages. */
+  };
+
+mapid_t mmap_map (struct file *, void *addr);
+bool mmap_unmap (mapid_t);
+void mmap_unmap_all (void);
+
+#endif /* vm/mmap.h */
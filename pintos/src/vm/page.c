@@ -0,0 +1,465 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Default maximum stack size, in pages: 8 MB. */
+#define STACK_PAGE_LIMIT_DEFAULT 2048
+
+size_t stack_page_limit = STACK_PAGE_LIMIT_DEFAULT;
+
+/* Number of pages added by page_reserve() that have not been
+   loaded yet, across all processes.  Guarded by reserve_lock. */
+static size_t reserved_cnt;
+static struct lock reserve_lock;
+
+/* Initializes the supplemental page table module. */
+void
+page_init (void)
+{
+  lock_init (&reserve_lock);
+}
+
+/* Releases the reservation held by page P, if any. */
+static void
+page_unreserve (struct page *p)
+{
+  if (p->reserved)
+    {
+      p->reserved = false;
+      lock_acquire (&reserve_lock);
+      reserved_cnt--;
+      lock_release (&reserve_lock);
+    }
+}
+
+/* Returns a hash value for page P. */
+static unsigned
+page_hash (const struct hash_elem *p_, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (p_, struct page, hash_elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+  return a->upage < b->upage;
+}
+
+/* Releases page P's frame or swap slot and frees P, first
+   writing P back to its file if it is a memory-mapped page that
+   has been modified.  Called before the page directory is
+   destroyed, so P's mapping is removed here to keep
+   pagedir_destroy() from freeing the frame a second time. */
+static void
+page_destroy (struct hash_elem *p_, void *aux UNUSED)
+{
+  struct page *p = hash_entry (p_, struct page, hash_elem);
+
+  /* Wait for an eviction in progress to finish. */
+  lock_acquire (&p->lock);
+  if (p->frame != NULL)
+    {
+      uint32_t *pd = p->owner->pagedir;
+
+      if (p->type == PAGE_MMAP && pagedir_is_dirty (pd, p->upage))
+        file_write_at (p->file, p->frame->kpage, p->read_bytes, p->ofs);
+      pagedir_clear_page (pd, p->upage);
+      frame_release (p->frame, p);
+    }
+  else if (p->type == PAGE_SWAP)
+    swap_free (p->swap_slot);
+  page_unreserve (p);
+  if (p->pinned)
+    list_remove (&p->pin_elem);
+  lock_release (&p->lock);
+  free (p);
+}
+
+/* Initializes the current process's supplemental page table,
+   along with its lists of pinned pages and of memory mappings.
+   Returns true if successful, false if out of memory. */
+bool
+page_table_init (void)
+{
+  struct thread *t = thread_current ();
+
+  list_init (&t->pinned_pages);
+  list_init (&t->mappings);
+  t->next_mapid = 0;
+  return hash_init (&t->pages, page_hash, page_less, NULL);
+}
+
+/* Destroys the current process's supplemental page table, if
+   page_table_init() succeeded, releasing every frame and swap
+   slot its pages hold.  Must be called before the page
+   directory is destroyed. */
+void
+page_table_destroy (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->pages.buckets != NULL)
+    hash_destroy (&t->pages, page_destroy);
+}
+
+/* Returns the page containing user virtual address ADDR in the
+   current process, or a null pointer if there is none. */
+struct page *
+page_lookup (const void *addr)
+{
+  struct page p;
+  struct hash_elem *e;
+
+  p.upage = pg_round_down (addr);
+  e = hash_find (&thread_current ()->pages, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Adds a page at UPAGE of the given TYPE to the current process
+   and returns it, or returns a null pointer if UPAGE is already
+   in use or memory is exhausted. */
+static struct page *
+page_add (void *upage, enum page_type type, bool writable)
+{
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->owner = thread_current ();
+  p->type = type;
+  p->writable = writable;
+  lock_init (&p->lock);
+  p->frame = NULL;
+  p->pinned = false;
+  p->reserved = false;
+  p->file = NULL;
+  p->ofs = 0;
+  p->read_bytes = 0;
+  if (hash_insert (&thread_current ()->pages, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Adds a page at UPAGE whose first READ_BYTES bytes are read
+   from FILE starting at offset OFS, and whose remaining bytes
+   are zeroed, when it is first touched.  Returns true if
+   successful, false if UPAGE is already in use or memory is
+   exhausted. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               uint32_t read_bytes, bool writable)
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  if (read_bytes == 0)
+    return page_add_zero (upage, writable);
+
+  p = page_add (upage, PAGE_FILE, writable);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  return true;
+}
+
+/* Adds a page at UPAGE that is zeroed when first touched.
+   Returns true if successful, false if UPAGE is already in use
+   or memory is exhausted. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  return page_add (upage, PAGE_ZERO, writable) != NULL;
+}
+
+/* Adds a zeroed, writable page at UPAGE, like page_add_zero(),
+   but first reserves memory for it: the page is added only if
+   the free frames and swap slots are enough to hold it along
+   with every other reserved page not yet touched.  Returns true
+   if successful, false if UPAGE is already in use or memory is
+   exhausted. */
+bool
+page_reserve (void *upage)
+{
+  struct page *p;
+  bool ok;
+
+  lock_acquire (&reserve_lock);
+  ok = reserved_cnt < palloc_user_free_cnt () + swap_free_cnt ();
+  if (ok)
+    reserved_cnt++;
+  lock_release (&reserve_lock);
+  if (!ok)
+    return false;
+
+  p = page_add (upage, PAGE_ZERO, true);
+  if (p == NULL)
+    {
+      lock_acquire (&reserve_lock);
+      reserved_cnt--;
+      lock_release (&reserve_lock);
+      return false;
+    }
+  p->reserved = true;
+  return true;
+}
+
+/* Adds a page at UPAGE that maps READ_BYTES bytes of FILE
+   starting at offset OFS, the rest of the page being zeroed.
+   Unlike a page added by page_add_file(), the page is written
+   back to FILE, rather than to swap, whenever it is evicted or
+   removed after being modified.  Returns true if successful,
+   false if UPAGE is already in use or memory is exhausted. */
+bool
+page_add_mmap (void *upage, struct file *file, off_t ofs,
+               uint32_t read_bytes)
+{
+  struct page *p;
+
+  ASSERT (read_bytes > 0 && read_bytes <= PGSIZE);
+
+  p = page_add (upage, PAGE_MMAP, true);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  return true;
+}
+
+/* Removes the page at UPAGE from the current process, which must
+   have one there, writing it back first if it is a modified
+   memory-mapped page. */
+void
+page_remove (void *upage)
+{
+  struct page *p = page_lookup (upage);
+
+  ASSERT (p != NULL);
+  hash_delete (&thread_current ()->pages, &p->hash_elem);
+  page_destroy (&p->hash_elem, NULL);
+}
+
+/* Reads page P, which must be locked and not present, into a
+   new frame and maps it.  A read-only page read from a file
+   instead maps the frame of another process's copy of the same
+   page, if there is one.  Returns true if successful, false if
+   no frame can be had. */
+static bool
+page_load (struct page *p)
+{
+  bool shareable = p->type == PAGE_FILE && !p->writable;
+  struct frame *f;
+  uint8_t *kpage;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (p->frame == NULL);
+
+  if (shareable)
+    {
+      f = frame_share (p);
+      if (f != NULL)
+        {
+          if (!pagedir_set_page (p->owner->pagedir, p->upage, f->kpage,
+                                 false))
+            {
+              frame_release (f, p);
+              return false;
+            }
+          p->frame = f;
+          return true;
+        }
+    }
+
+  f = frame_alloc (p, p->type == PAGE_ZERO);
+  if (f == NULL)
+    return false;
+  kpage = f->kpage;
+
+  switch (p->type)
+    {
+    case PAGE_FILE:
+    case PAGE_MMAP:
+      if (file_read_at (p->file, kpage, p->read_bytes, p->ofs)
+          != (off_t) p->read_bytes)
+        {
+          frame_release (f, p);
+          return false;
+        }
+      memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+      break;
+
+    case PAGE_ZERO:
+      /* frame_alloc() zeroed it. */
+      break;
+
+    case PAGE_SWAP:
+      swap_read (p->swap_slot, kpage);
+      break;
+
+    default:
+      NOT_REACHED ();
+    }
+
+  if (!pagedir_set_page (p->owner->pagedir, p->upage, kpage, p->writable))
+    {
+      frame_release (f, p);
+      return false;
+    }
+  if (p->type == PAGE_SWAP)
+    swap_free (p->swap_slot);
+  p->frame = f;
+  page_unreserve (p);
+  if (shareable)
+    frame_publish (f);
+  return true;
+}
+
+/* Makes the page containing user virtual address ADDR present in
+   the current process's page directory, reading it from its
+   backing store.  Returns true if successful, false if ADDR is
+   not in a known page or no frame can be had. */
+bool
+page_in (const void *addr)
+{
+  struct page *p = page_lookup (addr);
+  bool success;
+
+  if (p == NULL)
+    return false;
+
+  lock_acquire (&p->lock);
+  success = p->frame != NULL || page_load (p);
+  lock_release (&p->lock);
+  return success;
+}
+
+/* Adds a zeroed, writable stack page containing user virtual
+   address ADDR to the current process, if a reference to ADDR
+   with the user stack pointer at ESP looks like a stack access.
+   That is the case if ADDR lies within the stack's size limit
+   below PHYS_BASE and no more than 32 bytes below ESP, the
+   farthest that the PUSHA instruction reaches before it
+   decrements the stack pointer.  The page is not read in here.
+   Returns true if a page was added, false otherwise. */
+bool
+page_grow_stack (const void *addr, const void *esp)
+{
+  uintptr_t a = (uintptr_t) addr;
+  uintptr_t stack_bottom = (uintptr_t) PHYS_BASE - stack_page_limit * PGSIZE;
+
+  if (a >= (uintptr_t) PHYS_BASE || a < stack_bottom
+      || a + 32 < (uintptr_t) esp)
+    return false;
+  return page_add_zero (pg_round_down (addr), true);
+}
+
+/* Writes page P, whose lock the caller holds, out of its frame
+   and unmaps it.  A memory-mapped page that has been written to
+   goes back to its file.  Any other page that has been written
+   to, or that came from swap, goes to a swap slot.  Otherwise P
+   can simply be read again later.  The caller then owns P's
+   former frame.  Returns true if successful, false if P would
+   need swap space and there is none, in which case P is left as
+   it was. */
+bool
+page_out (struct page *p)
+{
+  uint32_t *pd = p->owner->pagedir;
+  bool need_slot = (p->type == PAGE_SWAP
+                    || (p->type != PAGE_MMAP && p->writable));
+  enum intr_level old_level;
+  size_t slot = 0;
+  bool dirty;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (p->frame != NULL);
+
+  if (need_slot && !swap_alloc (&slot))
+    return false;
+
+  /* Unmap the page before the owner can dirty it further. */
+  old_level = intr_disable ();
+  dirty = pagedir_is_dirty (pd, p->upage);
+  pagedir_clear_page (pd, p->upage);
+  intr_set_level (old_level);
+
+  if (p->type == PAGE_MMAP && dirty)
+    file_write_at (p->file, p->frame->kpage, p->read_bytes, p->ofs);
+  else if (need_slot && (p->type == PAGE_SWAP || dirty))
+    {
+      swap_write (slot, p->frame->kpage);
+      p->type = PAGE_SWAP;
+      p->swap_slot = slot;
+    }
+  else if (need_slot)
+    swap_free (slot);
+  p->frame = NULL;
+  return true;
+}
+
+/* Makes the page containing user virtual address ADDR present,
+   like page_in(), and keeps it from being evicted until the
+   next page_unpin_all().  System calls pin the user buffers
+   they are about to touch, so that they never fault on them.
+   Returns true if successful, false if ADDR is not in a known
+   page or no frame can be had. */
+bool
+page_pin (const void *addr)
+{
+  struct page *p = page_lookup (addr);
+  bool success;
+
+  if (p == NULL)
+    return false;
+
+  lock_acquire (&p->lock);
+  success = p->frame != NULL || page_load (p);
+  if (success && !p->pinned)
+    {
+      p->pinned = true;
+      list_push_back (&thread_current ()->pinned_pages, &p->pin_elem);
+    }
+  lock_release (&p->lock);
+  return success;
+}
+
+/* Unpins all of the current process's pinned pages. */
+void
+page_unpin_all (void)
+{
+  struct list *pinned = &thread_current ()->pinned_pages;
+
+  while (!list_empty (pinned))
+    {
+      struct page *p = list_entry (list_pop_front (pinned),
+                                   struct page, pin_elem);
+      lock_acquire (&p->lock);
+      p->pinned = false;
+      lock_release (&p->lock);
+    }
+}
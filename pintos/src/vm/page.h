@@ -0,0 +1,79 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+/* Supplemental page table.
+
+   Each process keeps a hash table, keyed by user virtual page,
+   of every page in its address space, whether or not it is
+   currently present in the page directory.  A page that is not
+   present is brought in by page_in(), called from the page fault
+   handler, according to where its contents come from, and may
+   later be evicted again by the frame table (see frame.c). */
+
+/* Where a page's contents come from when it is not present. */
+enum page_type
+  {
+    PAGE_FILE,                  /* Read from FILE, rest zeroed. */
+    PAGE_MMAP,                  /* Read from FILE, written back if dirty. */
+    PAGE_ZERO,                  /* All zeros. */
+    PAGE_SWAP                   /* Swap slot SWAP_SLOT, once evicted. */
+  };
+
+/* A page in a process's address space. */
+struct page
+  {
+    struct hash_elem hash_elem; /* Element in thread's `pages'. */
+    void *upage;                /* User virtual address. */
+    struct thread *owner;       /* Process the page belongs to. */
+    enum page_type type;        /* Backing store. */
+    bool writable;              /* May the process write the page? */
+
+    /* Paging in and out holds LOCK. */
+    struct lock lock;           /* Guards the members below. */
+    struct frame *frame;        /* Frame holding the page, or null. */
+    struct list_elem frame_elem; /* Element in frame's `pages'. */
+    bool pinned;                /* Not to be evicted? */
+    bool reserved;              /* Memory reserved, not yet loaded? */
+    struct list_elem pin_elem;  /* Element in owner's `pinned_pages'. */
+
+    /* PAGE_FILE and PAGE_MMAP only. */
+    struct file *file;          /* File to read. */
+    off_t ofs;                  /* Offset in FILE. */
+    uint32_t read_bytes;        /* Bytes to read; the rest is zeroed. */
+
+    /* PAGE_SWAP only. */
+    size_t swap_slot;           /* Swap slot, if not in a frame. */
+  };
+
+/* Maximum size of a process's stack, in pages.  Controlled by
+   kernel command-line option "-sl". */
+extern size_t stack_page_limit;
+
+void page_init (void);
+bool page_table_init (void);
+void page_table_destroy (void);
+
+struct page *page_lookup (const void *addr);
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    uint32_t read_bytes, bool writable);
+bool page_add_zero (void *upage, bool writable);
+bool page_add_mmap (void *upage, struct file *, off_t ofs,
+                    uint32_t read_bytes);
+bool page_reserve (void *upage);
+void page_remove (void *upage);
+bool page_in (const void *addr);
+bool page_grow_stack (const void *addr, const void *esp);
+bool page_out (struct page *);
+
+bool page_pin (const void *addr);
+void page_unpin_all (void);
+
+#endif /* vm/page.h */
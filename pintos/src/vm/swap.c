@@ -0,0 +1,98 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Sectors per swap slot. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Swap device, or null if there is none. */
+static struct block *swap_device;
+
+/* Slots in use.  Guarded by swap_lock. */
+static struct bitmap *swap_slots;
+static struct lock swap_lock;
+
+/* Sets up swap space on the BLOCK_SWAP device, if there is
+   one. */
+void
+swap_init (void)
+{
+  lock_init (&swap_lock);
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device == NULL)
+    {
+      printf ("swap: no swap device, user pages cannot be swapped\n");
+      return;
+    }
+  swap_slots = bitmap_create (block_size (swap_device) / PAGE_SECTORS);
+  if (swap_slots == NULL)
+    PANIC ("swap: bitmap creation failed");
+}
+
+/* Reserves a free swap slot and stores its number in *SLOT.
+   Returns true if successful, false if swap space is full or
+   there is no swap device. */
+bool
+swap_alloc (size_t *slot)
+{
+  size_t idx;
+
+  if (swap_slots == NULL)
+    return false;
+
+  lock_acquire (&swap_lock);
+  idx = bitmap_scan_and_flip (swap_slots, 0, 1, false);
+  lock_release (&swap_lock);
+
+  if (idx == BITMAP_ERROR)
+    return false;
+  *slot = idx;
+  return true;
+}
+
+/* Writes the page at KPAGE to reserved swap slot SLOT. */
+void
+swap_write (size_t slot, const void *kpage)
+{
+  ASSERT (bitmap_test (swap_slots, slot));
+  block_write_multiple (swap_device, slot * PAGE_SECTORS, PAGE_SECTORS,
+                        kpage);
+}
+
+/* Reads swap slot SLOT into the page at KPAGE. */
+void
+swap_read (size_t slot, void *kpage)
+{
+  ASSERT (bitmap_test (swap_slots, slot));
+  block_read_multiple (swap_device, slot * PAGE_SECTORS, PAGE_SECTORS,
+                       kpage);
+}
+
+/* Returns the number of free swap slots. */
+size_t
+swap_free_cnt (void)
+{
+  size_t cnt;
+
+  if (swap_slots == NULL)
+    return 0;
+
+  lock_acquire (&swap_lock);
+  cnt = bitmap_count (swap_slots, 0, bitmap_size (swap_slots), false);
+  lock_release (&swap_lock);
+  return cnt;
+}
+
+/* Releases swap slot SLOT. */
+void
+swap_free (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_slots, slot));
+  bitmap_reset (swap_slots, slot);
+  lock_release (&swap_lock);
+}
@@ -0,0 +1,20 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Swap space.
+
+   The BLOCK_SWAP device is divided into page-sized slots, tracked
+   by a bitmap.  Each slot is read or written with a single
+   multi-sector transfer. */
+
+void swap_init (void);
+bool swap_alloc (size_t *slot);
+void swap_write (size_t slot, const void *kpage);
+void swap_read (size_t slot, void *kpage);
+void swap_free (size_t slot);
+size_t swap_free_cnt (void);
+
+#endif /* vm/swap.h */